@@ -0,0 +1,160 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif defined(__aarch64__) && defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+static void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    __cpuidex((int*)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register states the OS saves on a context switch. AVX and AVX-512 can't be used unless it saves them.
+static uint64_t XGetBv(void) {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax;
+    uint32_t edx;
+
+    __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static uint32_t DetectCpuFeatures(void) {
+    uint32_t regs[4];
+    uint32_t maxLeaf;
+    uint32_t features = 0;
+    uint64_t xcr0 = 0;
+
+    CpuId(0, 0, regs);
+    maxLeaf = regs[0];
+
+    CpuId(1, 0, regs);
+    if (regs[2] & (1 << 20)) {
+        features |= CPU_FEATURE_SSE42;
+    }
+    if (regs[2] & (1 << 1)) {
+        features |= CPU_FEATURE_PCLMUL;
+    }
+    if (regs[2] & (1 << 9)) {
+        features |= CPU_FEATURE_SSSE3;
+    }
+    // OSXSAVE
+    if (regs[2] & (1 << 27)) {
+        xcr0 = XGetBv();
+    }
+
+    if (maxLeaf >= 7) {
+        CpuId(7, 0, regs);
+        // XMM and YMM state
+        if ((xcr0 & 0x6) == 0x6 && (regs[1] & (1 << 5))) {
+            features |= CPU_FEATURE_AVX2;
+        }
+        // XMM, YMM, opmask and ZMM state
+        if ((xcr0 & 0xE6) == 0xE6) {
+            if (regs[1] & (1 << 16)) {
+                features |= CPU_FEATURE_AVX512F;
+            }
+            if (regs[1] & (1 << 30)) {
+                features |= CPU_FEATURE_AVX512BW;
+            }
+            if (regs[2] & (1 << 10)) {
+                features |= CPU_FEATURE_VPCLMUL;
+            }
+        }
+    }
+    return features;
+}
+#elif defined(__aarch64__) && defined(__linux__)
+static uint32_t DetectCpuFeatures(void) {
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    uint32_t features = CPU_FEATURE_ARM_NEON;
+
+    if (hwcap & HWCAP_CRC32) {
+        features |= CPU_FEATURE_ARM_CRC32;
+    }
+    if (hwcap & HWCAP_PMULL) {
+        features |= CPU_FEATURE_ARM_PMULL;
+    }
+    if (hwcap & HWCAP_SHA3) {
+        features |= CPU_FEATURE_ARM_SHA3;
+    }
+    return features;
+}
+#elif defined(__aarch64__) && defined(__APPLE__)
+static int SysctlFlag(const char* name) {
+    int value = 0;
+    size_t size = sizeof(value);
+
+    if (sysctlbyname(name, &value, &size, NULL, 0) != 0) {
+        return 0;
+    }
+    return value;
+}
+
+static uint32_t DetectCpuFeatures(void) {
+    // Every Apple core has CRC32 and PMULL.
+    uint32_t features = CPU_FEATURE_ARM_NEON | CPU_FEATURE_ARM_CRC32 | CPU_FEATURE_ARM_PMULL;
+
+    if (SysctlFlag("hw.optional.armv8_2_sha3")) {
+        features |= CPU_FEATURE_ARM_SHA3;
+    }
+    return features;
+}
+#else
+// Nothing to ask. Trust whatever the compiler was told to target.
+static uint32_t DetectCpuFeatures(void) {
+    uint32_t features = 0;
+
+#if defined(__aarch64__)
+    features |= CPU_FEATURE_ARM_NEON;
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+    features |= CPU_FEATURE_ARM_CRC32;
+#endif
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+    features |= CPU_FEATURE_ARM_PMULL;
+#endif
+#if defined(__ARM_FEATURE_SHA3)
+    features |= CPU_FEATURE_ARM_SHA3;
+#endif
+    return features;
+}
+#endif
+
+// Set in the cached word once detection has run, so the features and whether they're valid are read together.
+#define CPU_FEATURES_DETECTED (1u << 31)
+
+uint32_t GetCpuFeatures(void) {
+    // Racing threads all store the same value, so no lock is needed.
+    static volatile uint32_t sFeatures;
+    uint32_t features = CPU_DISPATCH_LOAD(&sFeatures);
+
+    if (!(features & CPU_FEATURES_DETECTED)) {
+        features = DetectCpuFeatures() | CPU_FEATURES_DETECTED;
+        CPU_DISPATCH_STORE(&sFeatures, features);
+    }
+    return features & ~CPU_FEATURES_DETECTED;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    CPU_FEATURE_SSE42 = 1 << 0,
+    CPU_FEATURE_PCLMUL = 1 << 1,
+    CPU_FEATURE_SSSE3 = 1 << 2,
+    CPU_FEATURE_AVX2 = 1 << 3,
+    CPU_FEATURE_AVX512F = 1 << 4,
+    CPU_FEATURE_AVX512BW = 1 << 5,
+    CPU_FEATURE_VPCLMUL = 1 << 6,
+    CPU_FEATURE_ARM_NEON = 1 << 7,
+    CPU_FEATURE_ARM_CRC32 = 1 << 8,
+    CPU_FEATURE_ARM_PMULL = 1 << 9,
+    CPU_FEATURE_ARM_SHA3 = 1 << 10,
+};
+
+// Returns the CPU_FEATURE_* bits the CPU and OS support. Detected once and cached.
+uint32_t GetCpuFeatures(void);
+
+// Loads and stores for state that's resolved lazily and may be raced on, like the feature word and the bound kernels.
+// The variable must be declared volatile. Racing threads may all resolve it, but every load sees a whole value, and
+// whatever its writer stored before it.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_DISPATCH_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define CPU_DISPATCH_STORE(p, value) __atomic_store_n((p), (value), __ATOMIC_RELEASE)
+#else
+// Aligned word accesses are atomic here, and volatile keeps the compiler from splitting, caching or reordering them.
+#define CPU_DISPATCH_LOAD(p) (*(p))
+#define CPU_DISPATCH_STORE(p, value) (*(p) = (value))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
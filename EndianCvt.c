@@ -1,5 +1,10 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "EndianCvt.h"
+#include "FastCrc32C.h"
+#include "CpuFeatures.h"
 
 #ifndef _MSC_VER
 #include <byteswap.h>
@@ -10,25 +15,494 @@
 #define BSWAP16 _byteswap_ushort
 #endif
 
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define SWAP_ARCH_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SWAP_ARCH_ARM64
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_ATTR(features) __attribute__((target(features)))
+#else
+#define TARGET_ATTR(features)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-void RomToBigEndian(void* rom, size_t romSize) {
-    uint8_t firstbyte = ((uint8_t*)rom)[0];
 
-    switch (firstbyte) {
-        case 0x80:  // BE
-            return; // Already BE, no need to swap
-        case 0x37:
-            for (size_t pos = 0; pos < (romSize / 2); pos++) {
-                ((uint16_t*)rom)[pos] = BSWAP16(((uint16_t*)rom)[pos]);
+// A kernel reverses every unit (2 or 4 byte) word of src into dst. dst and src are either the same buffer or don't
+// overlap. Bytes past the last whole unit are left alone.
+typedef void (*RomSwapKernelFn)(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit);
+
+// Swaps one unit at a time. Goes through memcpy so the buffer never has to be aligned for or aliased as uint16_t and
+// uint32_t.
+static void RomSwapScalar(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    size_t pos;
+
+    if (unit == 2) {
+        for (pos = 0; pos + 2 <= size; pos += 2) {
+            uint16_t v;
+
+            memcpy(&v, src + pos, sizeof(v));
+            v = BSWAP16(v);
+            memcpy(dst + pos, &v, sizeof(v));
+        }
+    } else {
+        for (pos = 0; pos + 4 <= size; pos += 4) {
+            uint32_t v;
+
+            memcpy(&v, src + pos, sizeof(v));
+            v = BSWAP32(v);
+            memcpy(dst + pos, &v, sizeof(v));
+        }
+    }
+}
+
+// Swaps single units until dst sits on a width byte boundary so the vector loop stores aligned. Skipped when dst is
+// not unit aligned, since stepping by units would never get there. Returns how many bytes it handled.
+static size_t RomSwapHead(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit, size_t width) {
+    size_t head;
+
+    if ((uintptr_t)dst % unit != 0) {
+        return 0;
+    }
+    head = (width - (uintptr_t)dst % width) % width;
+    if (head > size) {
+        head = size - size % unit;
+    }
+    RomSwapScalar(dst, src, head, unit);
+    return head;
+}
+
+#ifdef SWAP_ARCH_X86
+static const unsigned char sSwapMask16[16] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 };
+static const unsigned char sSwapMask32[16] = { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+
+// The vector kernels share a body between a normal and a streaming variant. Streaming stores bypass the cache, which
+// is what a large out of place copy wants, but need an aligned destination, so the body drops back to normal stores
+// when the head couldn't align it.
+#define SWAP_STORE128(stream, p, v) ((stream) ? _mm_stream_si128((p), (v)) : _mm_storeu_si128((p), (v)))
+#define SWAP_STORE256(stream, p, v) ((stream) ? _mm256_stream_si256((p), (v)) : _mm256_storeu_si256((p), (v)))
+#define SWAP_STORE512(stream, p, v) ((stream) ? _mm512_stream_si512((void*)(p), (v)) : _mm512_storeu_si512((p), (v)))
+
+TARGET_ATTR("ssse3")
+static inline void RomSwapSsse3Body(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit,
+                                    int stream) {
+    const __m128i mask = _mm_loadu_si128((const __m128i*)(unit == 2 ? sSwapMask16 : sSwapMask32));
+    size_t pos = RomSwapHead(dst, src, size, unit, 16);
+
+    stream = stream && (uintptr_t)(dst + pos) % 16 == 0;
+
+    for (; pos + 64 <= size; pos += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + pos));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + pos + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + pos + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + pos + 48));
+
+        SWAP_STORE128(stream, (__m128i*)(dst + pos), _mm_shuffle_epi8(a, mask));
+        SWAP_STORE128(stream, (__m128i*)(dst + pos + 16), _mm_shuffle_epi8(b, mask));
+        SWAP_STORE128(stream, (__m128i*)(dst + pos + 32), _mm_shuffle_epi8(c, mask));
+        SWAP_STORE128(stream, (__m128i*)(dst + pos + 48), _mm_shuffle_epi8(d, mask));
+    }
+    for (; pos + 16 <= size; pos += 16) {
+        SWAP_STORE128(stream, (__m128i*)(dst + pos),
+                      _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + pos)), mask));
+    }
+    if (stream) {
+        _mm_sfence();
+    }
+    RomSwapScalar(dst + pos, src + pos, size - pos, unit);
+}
+
+TARGET_ATTR("ssse3")
+static void RomSwapSsse3(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapSsse3Body(dst, src, size, unit, 0);
+}
+
+TARGET_ATTR("ssse3")
+static void RomSwapSsse3Stream(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapSsse3Body(dst, src, size, unit, 1);
+}
+
+// vpshufb shuffles within each 128 bit lane, so the same 16 byte mask is broadcast to every lane.
+TARGET_ATTR("avx2")
+static inline void RomSwapAvx2Body(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit,
+                                   int stream) {
+    const __m256i mask = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i*)(unit == 2 ? sSwapMask16 : sSwapMask32)));
+    size_t pos = RomSwapHead(dst, src, size, unit, 32);
+
+    stream = stream && (uintptr_t)(dst + pos) % 32 == 0;
+
+    for (; pos + 128 <= size; pos += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + pos));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + pos + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + pos + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + pos + 96));
+
+        SWAP_STORE256(stream, (__m256i*)(dst + pos), _mm256_shuffle_epi8(a, mask));
+        SWAP_STORE256(stream, (__m256i*)(dst + pos + 32), _mm256_shuffle_epi8(b, mask));
+        SWAP_STORE256(stream, (__m256i*)(dst + pos + 64), _mm256_shuffle_epi8(c, mask));
+        SWAP_STORE256(stream, (__m256i*)(dst + pos + 96), _mm256_shuffle_epi8(d, mask));
+    }
+    for (; pos + 32 <= size; pos += 32) {
+        SWAP_STORE256(stream, (__m256i*)(dst + pos),
+                      _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + pos)), mask));
+    }
+    if (stream) {
+        _mm_sfence();
+    }
+    RomSwapScalar(dst + pos, src + pos, size - pos, unit);
+}
+
+TARGET_ATTR("avx2")
+static void RomSwapAvx2(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapAvx2Body(dst, src, size, unit, 0);
+}
+
+TARGET_ATTR("avx2")
+static void RomSwapAvx2Stream(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapAvx2Body(dst, src, size, unit, 1);
+}
+
+TARGET_ATTR("avx512f,avx512bw")
+static inline void RomSwapAvx512Body(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit,
+                                     int stream) {
+    const __m512i mask =
+        _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(unit == 2 ? sSwapMask16 : sSwapMask32)));
+    size_t pos = RomSwapHead(dst, src, size, unit, 64);
+
+    stream = stream && (uintptr_t)(dst + pos) % 64 == 0;
+
+    for (; pos + 256 <= size; pos += 256) {
+        __m512i a = _mm512_loadu_si512(src + pos);
+        __m512i b = _mm512_loadu_si512(src + pos + 64);
+        __m512i c = _mm512_loadu_si512(src + pos + 128);
+        __m512i d = _mm512_loadu_si512(src + pos + 192);
+
+        SWAP_STORE512(stream, dst + pos, _mm512_shuffle_epi8(a, mask));
+        SWAP_STORE512(stream, dst + pos + 64, _mm512_shuffle_epi8(b, mask));
+        SWAP_STORE512(stream, dst + pos + 128, _mm512_shuffle_epi8(c, mask));
+        SWAP_STORE512(stream, dst + pos + 192, _mm512_shuffle_epi8(d, mask));
+    }
+    for (; pos + 64 <= size; pos += 64) {
+        SWAP_STORE512(stream, dst + pos, _mm512_shuffle_epi8(_mm512_loadu_si512(src + pos), mask));
+    }
+    if (stream) {
+        _mm_sfence();
+    }
+    // The last partial vector goes through a byte mask instead of the scalar loop.
+    if (pos < size) {
+        const size_t rest = (size - pos) - (size - pos) % unit;
+        const __mmask64 tail = ((__mmask64)1 << rest) - 1;
+
+        _mm512_mask_storeu_epi8(dst + pos, tail, _mm512_shuffle_epi8(_mm512_maskz_loadu_epi8(tail, src + pos), mask));
+    }
+}
+
+TARGET_ATTR("avx512f,avx512bw")
+static void RomSwapAvx512(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapAvx512Body(dst, src, size, unit, 0);
+}
+
+TARGET_ATTR("avx512f,avx512bw")
+static void RomSwapAvx512Stream(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwapAvx512Body(dst, src, size, unit, 1);
+}
+#endif
+
+#ifdef SWAP_ARCH_ARM64
+static void RomSwapNeon(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    size_t pos = RomSwapHead(dst, src, size, unit, 16);
+
+    if (unit == 2) {
+        for (; pos + 64 <= size; pos += 64) {
+            uint8x16_t a = vld1q_u8(src + pos);
+            uint8x16_t b = vld1q_u8(src + pos + 16);
+            uint8x16_t c = vld1q_u8(src + pos + 32);
+            uint8x16_t d = vld1q_u8(src + pos + 48);
+
+            vst1q_u8(dst + pos, vrev16q_u8(a));
+            vst1q_u8(dst + pos + 16, vrev16q_u8(b));
+            vst1q_u8(dst + pos + 32, vrev16q_u8(c));
+            vst1q_u8(dst + pos + 48, vrev16q_u8(d));
+        }
+        for (; pos + 16 <= size; pos += 16) {
+            vst1q_u8(dst + pos, vrev16q_u8(vld1q_u8(src + pos)));
+        }
+    } else {
+        for (; pos + 64 <= size; pos += 64) {
+            uint8x16_t a = vld1q_u8(src + pos);
+            uint8x16_t b = vld1q_u8(src + pos + 16);
+            uint8x16_t c = vld1q_u8(src + pos + 32);
+            uint8x16_t d = vld1q_u8(src + pos + 48);
+
+            vst1q_u8(dst + pos, vrev32q_u8(a));
+            vst1q_u8(dst + pos + 16, vrev32q_u8(b));
+            vst1q_u8(dst + pos + 32, vrev32q_u8(c));
+            vst1q_u8(dst + pos + 48, vrev32q_u8(d));
+        }
+        for (; pos + 16 <= size; pos += 16) {
+            vst1q_u8(dst + pos, vrev32q_u8(vld1q_u8(src + pos)));
+        }
+    }
+    RomSwapScalar(dst + pos, src + pos, size - pos, unit);
+}
+#endif
+
+typedef struct RomSwapKernelInfo {
+    const char* name;
+    RomSwapKernelFn fn;
+    // Variant for large out of place copies. Uses non-temporal stores where the ISA has them.
+    RomSwapKernelFn streamFn;
+    uint32_t cpuFeatures;
+} RomSwapKernelInfo;
+
+// Indexed by RomSwapKernel. Kernels that can't be built for this architecture have no function.
+static const RomSwapKernelInfo sRomSwapKernels[ROM_SWAP_KERNEL_COUNT] = {
+    { "auto", NULL, NULL, 0 },
+    { "scalar", RomSwapScalar, RomSwapScalar, 0 },
+#ifdef SWAP_ARCH_X86
+    { "ssse3", RomSwapSsse3, RomSwapSsse3Stream, CPU_FEATURE_SSSE3 },
+    { "avx2", RomSwapAvx2, RomSwapAvx2Stream, CPU_FEATURE_AVX2 },
+    { "avx512", RomSwapAvx512, RomSwapAvx512Stream, CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512BW },
+#else
+    { "ssse3", NULL, NULL, 0 },
+    { "avx2", NULL, NULL, 0 },
+    { "avx512", NULL, NULL, 0 },
+#endif
+#ifdef SWAP_ARCH_ARM64
+    { "neon", RomSwapNeon, RomSwapNeon, CPU_FEATURE_ARM_NEON },
+#else
+    { "neon", NULL, NULL, 0 },
+#endif
+};
+
+static const RomSwapKernel sRomSwapPreference[] = {
+    ROM_SWAP_KERNEL_AVX512, ROM_SWAP_KERNEL_AVX2,   ROM_SWAP_KERNEL_SSSE3,
+    ROM_SWAP_KERNEL_NEON,   ROM_SWAP_KERNEL_SCALAR,
+};
+
+static void RomSwapResolve(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit);
+static void RomSwapStreamResolve(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit);
+
+// Same lazy binding as the CRC32C dispatcher.
+static RomSwapKernelFn volatile sRomSwapImpl = RomSwapResolve;
+static RomSwapKernelFn volatile sRomSwapStreamImpl = RomSwapStreamResolve;
+static volatile RomSwapKernel sRomSwapKernel = ROM_SWAP_KERNEL_AUTO;
+
+int RomSwap_KernelSupported(RomSwapKernel kernel) {
+    if (kernel <= ROM_SWAP_KERNEL_AUTO || kernel >= ROM_SWAP_KERNEL_COUNT || sRomSwapKernels[kernel].fn == NULL) {
+        return 0;
+    }
+    return (GetCpuFeatures() & sRomSwapKernels[kernel].cpuFeatures) == sRomSwapKernels[kernel].cpuFeatures;
+}
+
+const char* RomSwap_KernelName(RomSwapKernel kernel) {
+    if (kernel < ROM_SWAP_KERNEL_AUTO || kernel >= ROM_SWAP_KERNEL_COUNT) {
+        return NULL;
+    }
+    return sRomSwapKernels[kernel].name;
+}
+
+RomSwapKernel RomSwap_KernelFromName(const char* name) {
+    for (int i = 0; i < ROM_SWAP_KERNEL_COUNT; i++) {
+        if (strcmp(name, sRomSwapKernels[i].name) == 0) {
+            return (RomSwapKernel)i;
+        }
+    }
+    return ROM_SWAP_KERNEL_COUNT;
+}
+
+RomSwapKernel RomSwap_GetKernel(void) {
+    if (CPU_DISPATCH_LOAD(&sRomSwapKernel) == ROM_SWAP_KERNEL_AUTO) {
+        RomSwap_SetKernel(ROM_SWAP_KERNEL_AUTO);
+    }
+    return CPU_DISPATCH_LOAD(&sRomSwapKernel);
+}
+
+int RomSwap_SetKernel(RomSwapKernel kernel) {
+    if (kernel == ROM_SWAP_KERNEL_AUTO) {
+        const char* forced = getenv(ROM_SWAP_KERNEL_ENV);
+
+        if (forced != NULL && RomSwap_KernelSupported(RomSwap_KernelFromName(forced))) {
+            kernel = RomSwap_KernelFromName(forced);
+        } else {
+            for (size_t i = 0; i < sizeof(sRomSwapPreference) / sizeof(sRomSwapPreference[0]); i++) {
+                if (RomSwap_KernelSupported(sRomSwapPreference[i])) {
+                    kernel = sRomSwapPreference[i];
+                    break;
+                }
             }
-            return;
+        }
+    } else if (!RomSwap_KernelSupported(kernel)) {
+        return 0;
+    }
+
+    CPU_DISPATCH_STORE(&sRomSwapKernel, kernel);
+    CPU_DISPATCH_STORE(&sRomSwapImpl, sRomSwapKernels[kernel].fn);
+    CPU_DISPATCH_STORE(&sRomSwapStreamImpl, sRomSwapKernels[kernel].streamFn);
+    return 1;
+}
+
+static void RomSwapResolve(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwap_SetKernel(ROM_SWAP_KERNEL_AUTO);
+    CPU_DISPATCH_LOAD(&sRomSwapImpl)(dst, src, size, unit);
+}
+
+static void RomSwapStreamResolve(unsigned char* dst, const unsigned char* src, size_t size, unsigned unit) {
+    RomSwap_SetKernel(ROM_SWAP_KERNEL_AUTO);
+    CPU_DISPATCH_LOAD(&sRomSwapStreamImpl)(dst, src, size, unit);
+}
+
+// Size of the words to reverse, judged from the first byte. 0 means the ROM is already big endian.
+static unsigned RomSwapUnit(const void* rom) {
+    switch (((const uint8_t*)rom)[0]) {
+        case 0x37:
+            return 2;
         case 0x40:
-            for (size_t pos = 0; pos < (romSize / 4); pos++) {
-                ((uint32_t*)rom)[pos] = BSWAP32(((uint32_t*)rom)[pos]);
-            }
+            return 4;
+        case 0x80: // BE
+        default:
+            return 0;
+    }
+}
+
+void RomToBigEndian(void* rom, size_t romSize) {
+    const unsigned unit = RomSwapUnit(rom);
+
+    if (unit != 0) {
+        CPU_DISPATCH_LOAD(&sRomSwapImpl)((unsigned char*)rom, (const unsigned char*)rom, romSize, unit);
+    }
+}
+
+void RomCopyToBigEndian(void* dst, const void* src, size_t romSize) {
+    const unsigned unit = RomSwapUnit(src);
+
+    if (unit == 0) {
+        memcpy(dst, src, romSize);
+    } else if (romSize >= ROM_STREAM_THRESHOLD) {
+        CPU_DISPATCH_LOAD(&sRomSwapStreamImpl)((unsigned char*)dst, (const unsigned char*)src, romSize, unit);
+    } else {
+        CPU_DISPATCH_LOAD(&sRomSwapImpl)((unsigned char*)dst, (const unsigned char*)src, romSize, unit);
+    }
+    // A trailing partial word isn't swapped, but it still has to end up in the copy.
+    if (unit != 0 && romSize % unit != 0) {
+        memcpy((unsigned char*)dst + romSize - romSize % unit, (const unsigned char*)src + romSize - romSize % unit,
+               romSize % unit);
+    }
+}
+
+const void* RomViewAsBigEndian(void* scratch, const void* src, size_t romSize) {
+    if (RomSwapUnit(src) == 0) {
+        return src;
+    }
+    RomCopyToBigEndian(scratch, src, romSize);
+    return scratch;
+}
+
+void RomCrc32C_Init(RomCrc32CState* state) {
+    CRC32C_Init(&state->crc);
+    state->unit = 0;
+}
+
+static void RomCrc32CUpdateBlocks(RomCrc32CState* state, unsigned char* bytes, size_t dataSize,
+                                  RomHeaderFixup fixHeader) {
+    for (size_t pos = 0; pos < dataSize; pos += ROM_FUSED_BLOCK) {
+        const size_t block = dataSize - pos < ROM_FUSED_BLOCK ? dataSize - pos : ROM_FUSED_BLOCK;
+
+        if (state->unit != 0) {
+            CPU_DISPATCH_LOAD(&sRomSwapImpl)(bytes + pos, bytes + pos, block, state->unit);
+        }
+        if (state->crc.length == 0 && fixHeader != NULL) {
+            fixHeader(bytes, block);
+        }
+        CRC32C_Update(&state->crc, bytes + pos, block);
+    }
+}
+
+void RomCrc32C_Update(RomCrc32CState* state, void* data, size_t dataSize, RomHeaderFixup fixHeader) {
+    unsigned char* bytes = (unsigned char*)data;
+    size_t run;
+    size_t start;
+
+    if (state->crc.length == 0 && dataSize != 0) {
+        state->unit = RomSwapUnit(data);
+    }
+    // The padding of 54MB and 64MB images is a constant fill, which reads the same in any byte order. A long run at
+    // the end of the piece is accounted for with CRC32C_UpdateRun, neither swapped nor hashed. Pieces that are all
+    // padding cost next to nothing.
+    run = CRC32C_TrailingRunLength(bytes, dataSize);
+    if (run < CRC32C_MIN_PADDING) {
+        RomCrc32CUpdateBlocks(state, bytes, dataSize, fixHeader);
+        return;
+    }
+    start = dataSize - run;
+    // Keep the swapped part whole words, and the header where fixHeader gets to see it.
+    if (state->unit != 0) {
+        start = (start + state->unit - 1) / state->unit * state->unit;
+    }
+    if (state->crc.length == 0 && fixHeader != NULL && start < ROM_FUSED_BLOCK) {
+        start = dataSize < ROM_FUSED_BLOCK ? dataSize : ROM_FUSED_BLOCK;
+    }
+    RomCrc32CUpdateBlocks(state, bytes, start, fixHeader);
+    CRC32C_UpdateRun(&state->crc, bytes[dataSize - 1], dataSize - start);
+}
+
+uint32_t RomCrc32C_Final(const RomCrc32CState* state) {
+    return CRC32C_Final(&state->crc);
+}
+
+uint32_t RomToBigEndianCrc32C(void* rom, size_t romSize, RomHeaderFixup fixHeader) {
+    RomCrc32CState state;
+
+    if (RomSwapUnit(rom) == 0) {
+        // Nothing to swap, so the only pass is the hash and it can use every core and skip the padding.
+        if (fixHeader != NULL) {
+            fixHeader((unsigned char*)rom, romSize);
+        }
+        return CRC32C_SkipPadding((const unsigned char*)rom, romSize);
+    }
+
+    RomCrc32C_Init(&state);
+    RomCrc32C_Update(&state, rom, romSize, fixHeader);
+    return RomCrc32C_Final(&state);
+}
+
+uint32_t RomCrc32CAsBigEndian(const void* rom, size_t romSize, RomHeaderFixup fixHeader) {
+    const unsigned char* data = (const unsigned char*)rom;
+    const unsigned unit = RomSwapUnit(rom);
+    unsigned char scratch[ROM_FUSED_BLOCK];
+    Crc32cState state;
+
+    if (unit == 0) {
+        // Only the header block needs a private copy, and only if something wants to patch it.
+        const size_t head = romSize < ROM_FUSED_BLOCK ? romSize : ROM_FUSED_BLOCK;
+
+        if (fixHeader == NULL) {
+            return CRC32C_SkipPadding(data, romSize);
+        }
+        memcpy(scratch, data, head);
+        fixHeader(scratch, head);
+        return CRC32C_Combine(CRC32C(scratch, head), CRC32C_SkipPadding(data + head, romSize - head), romSize - head);
+    }
+
+    CRC32C_Init(&state);
+    for (size_t pos = 0; pos < romSize; pos += ROM_FUSED_BLOCK) {
+        const size_t block = romSize - pos < ROM_FUSED_BLOCK ? romSize - pos : ROM_FUSED_BLOCK;
+
+        CPU_DISPATCH_LOAD(&sRomSwapImpl)(scratch, data + pos, block, unit);
+        // The kernels leave a trailing partial word alone, which in scratch means uninitialized.
+        memcpy(scratch + block - block % unit, data + pos + block - block % unit, block % unit);
+        if (pos == 0 && fixHeader != NULL) {
+            fixHeader(scratch, block);
+        }
+        CRC32C_Update(&state, scratch, block);
     }
+    return CRC32C_Final(&state);
 }
 
 #ifdef __cplusplus
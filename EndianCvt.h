@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FastCrc32C.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Environment variable that forces a byte swap kernel by name, e.g. OTR_BSWAP_KERNEL=ssse3.
+#define ROM_SWAP_KERNEL_ENV "OTR_BSWAP_KERNEL"
+
+typedef enum RomSwapKernel {
+    ROM_SWAP_KERNEL_AUTO,
+    ROM_SWAP_KERNEL_SCALAR,
+    ROM_SWAP_KERNEL_SSSE3,
+    ROM_SWAP_KERNEL_AVX2,
+    ROM_SWAP_KERNEL_AVX512,
+    ROM_SWAP_KERNEL_NEON,
+    ROM_SWAP_KERNEL_COUNT,
+} RomSwapKernel;
+
+// Detects the byte order from the first byte and swaps the ROM to big endian (.z64) in place.
+void RomToBigEndian(void* rom, size_t romSize);
+
+// Copies below this size use normal stores, since the caller is likely to read the copy back while it's cached.
+#define ROM_STREAM_THRESHOLD (4 * 1024 * 1024)
+
+// Out of place RomToBigEndian. Copies src into dst in big endian order in one pass, so src can be read only (a
+// mapped file for example). dst and src must not overlap. Large copies use non-temporal stores.
+void RomCopyToBigEndian(void* dst, const void* src, size_t romSize);
+
+// Returns a big endian view of src. That is src itself if it is already big endian, so no copy is made. Otherwise the
+// swapped copy is written to scratch, which must hold romSize bytes, and scratch is returned.
+const void* RomViewAsBigEndian(void* scratch, const void* src, size_t romSize);
+
+// Called on the freshly swapped start of the ROM, before any of it is hashed, so the caller can patch the header.
+// size is how many bytes of the ROM are available, at least ROM_FUSED_BLOCK unless the ROM is smaller.
+typedef void (*RomHeaderFixup)(unsigned char* rom, size_t size);
+
+// Block size for the fused pass. Small enough that a swapped block is still in L1 when the CRC reads it back.
+#define ROM_FUSED_BLOCK (16 * 1024)
+
+// RomToBigEndian and CRC32C in one pass over memory. Each block is swapped and then hashed while it is still in L1,
+// instead of swapping all 64MB and then reading it all again. fixHeader may be NULL. Returns the CRC32C of the big
+// endian (and fixed) image.
+uint32_t RomToBigEndianCrc32C(void* rom, size_t romSize, RomHeaderFixup fixHeader);
+
+// Incremental RomToBigEndianCrc32C for a ROM that arrives in pieces, e.g. off disk. The first Update must start at the
+// ROM's first byte, where the byte order is detected, and should be at least ROM_FUSED_BLOCK bytes so fixHeader sees
+// the whole header. Every piece but the last must be a multiple of 4 bytes. Each piece is swapped in place.
+typedef struct RomCrc32CState {
+    Crc32cState crc;
+    unsigned unit;
+} RomCrc32CState;
+
+void RomCrc32C_Init(RomCrc32CState* state);
+void RomCrc32C_Update(RomCrc32CState* state, void* data, size_t dataSize, RomHeaderFixup fixHeader);
+uint32_t RomCrc32C_Final(const RomCrc32CState* state);
+
+// Same result as RomToBigEndianCrc32C, but rom is only read. Each block is swapped into an L1 sized scratch buffer
+// and hashed from there, so a v64 or n64 dump can be validated without ever being normalized in memory.
+uint32_t RomCrc32CAsBigEndian(const void* rom, size_t romSize, RomHeaderFixup fixHeader);
+
+// Same contract as CRC32C_SetKernel and friends.
+int RomSwap_SetKernel(RomSwapKernel kernel);
+RomSwapKernel RomSwap_GetKernel(void);
+int RomSwap_KernelSupported(RomSwapKernel kernel);
+const char* RomSwap_KernelName(RomSwapKernel kernel);
+RomSwapKernel RomSwap_KernelFromName(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,19 +2,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <Windows.h>
 #include <winuser.h>
-#include <shlwapi.h>
-#pragma comment(lib, "Shlwapi.lib")
 #endif
 
 #include "portable-file-dialogs.h"
 
-#ifdef unix
-#include <dirent.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#endif
-
 #if __has_include(<byteswap.h>)
 #include "byteswap.h"
 #define _byteswap_ulong(x) bswap_32(x)
@@ -28,8 +19,10 @@
 #define UNREACHABLE __builtin_unreachable();
 #endif
 
+#include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef SDL_MAIN_HANDLED
 #define SDL_MAIN_HANDLED
@@ -51,14 +44,23 @@
 #endif
 
 #include <array>
+#include <condition_variable>
 #include <fstream>
 #include <filesystem>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
 #include <vector>
 
-extern "C" uint32_t CRC32C(unsigned char* data, size_t dataSize);
-extern "C" void RomToBigEndian(void* rom, size_t romSize);
+#include "FastCrc32C.h"
+#include "EndianCvt.h"
+#include "RomLoader.h"
+#include "RomDiscovery.h"
+#include "RomCache.h"
+#include "RomWatch.h"
 
 static constexpr uint32_t OOT_NTSC_10 = 0xEC7011B7;
 static constexpr uint32_t OOT_NTSC_11 = 0xD43DA81F;
@@ -118,15 +120,21 @@ enum class ButtonId : int {
 };
 
 class Extractor {
-    std::unique_ptr<unsigned char[]> mRomData = std::make_unique<unsigned char[]>(MB64);
     std::string mCurrentRomPath;
     size_t mCurRomSize = 0;
+    uint32_t mRomCrc = 0;
+    // Only the header is kept. It's big endian no matter what order the file is in.
+    unsigned char mRomHeader[ROM_HEADER_SIZE] = { 0 };
+    // What earlier runs learned about each rom, so unchanged files aren't read again.
+    RomCache* mCache = RomCache_Open(nullptr);
 
     bool GetRomPathFromBox();
 
     uint32_t GetRomVerCrc();
     size_t GetCurRomSize();
-    bool ValidateAndFixRom();
+    bool LoadRom();
+    bool LoadAndValidateRom();
+    bool ValidateRomCrc();
     bool ValidateRomSize();
 
     bool ValidateRom(bool skipCrcBox = false);
@@ -137,13 +145,18 @@ class Extractor {
     int ShowYesNoBox(const char* title, const char* text);
     void SetRomInfo(const std::string& path);
 
-    void GetRoms(std::vector<std::string>& roms);
+    void GetRoms(std::vector<std::string>& roms, std::vector<RomBatchResult>& probes);
     void ShowSizeErrorBox();
     void ShowCrcErrorBox();
     int ShowRomPickBox(uint32_t verCrc);
 
+    static void OnRomWatched(void* user, RomWatchEvent event, const RomCandidate* candidates, size_t count);
+    void CheckWatchedRoms(const RomCandidate* candidates, size_t count);
+
   public:
+    ~Extractor();
     bool Run();
+    bool Watch();
     const char* GetZapdStr();
 };
 
@@ -209,62 +222,210 @@ int Extractor::ShowYesNoBox(const char* title, const char* box) {
     return ret;
 }
 
+Extractor::~Extractor() {
+    RomCache_Save(mCache);
+    RomCache_Close(mCache);
+}
+
 void Extractor::SetRomInfo(const std::string& path) {
     mCurrentRomPath = path;
     mCurRomSize = GetCurRomSize();
 }
 
-void Extractor::GetRoms(std::vector<std::string>& roms) {
-#ifdef _WIN32
-    WIN32_FIND_DATAA ffd;
-    HANDLE h = FindFirstFileA("\\*", &ffd);
+// Where to look for roms. Set from the command line. With no roots, only the working directory is searched, and
+// not recursively unless a depth is given.
+struct RomSearch {
+    std::vector<const char*> roots;
+    std::vector<const char*> excludes;
+    int maxDepth = -1;
+    bool maxDepthSet = false;
+    // Keep watching the roots and check roms as they're added, instead of extracting one.
+    bool watch = false;
+    // Also look inside rom sized files with other extensions, or none.
+    bool sniff = false;
+};
+
+static RomSearch sRomSearch;
+// Report how roms were read, e.g. whether huge pages backed the buffers.
+static bool sVerbose = false;
+
+static RomCrawlOptions GetRomSearchOptions() {
+    static const char* const defaultRoots[] = { "." };
+    RomCrawlOptions options = {};
+
+    if (sRomSearch.roots.empty()) {
+        options.roots = defaultRoots;
+        options.rootCount = 1;
+        options.maxDepth = sRomSearch.maxDepthSet ? sRomSearch.maxDepth : 0;
+    } else {
+        options.roots = sRomSearch.roots.data();
+        options.rootCount = sRomSearch.roots.size();
+        options.maxDepth = sRomSearch.maxDepth;
+    }
+    options.excludes = sRomSearch.excludes.data();
+    options.excludeCount = sRomSearch.excludes.size();
+    options.followSymlinks = 1;
+    options.sniff = sRomSearch.sniff;
+    return options;
+}
+
+static void FixRomHeader(unsigned char* rom, size_t size);
+
+// A rom waiting for its header to be probed. Copied out of the scan so the prober never reads roms while the crawl
+// grows it.
+struct RomProbeJob {
+    // Index into roms.
+    size_t rom;
+    std::string path;
+    // Everything but path.
+    RomCandidate file;
+};
+
+struct RomScan {
+    std::vector<std::string>* roms = nullptr;
+    std::vector<RomBatchResult>* probes = nullptr;
+    RomCache* cache = nullptr;
+    // What discovery found out about each rom, parallel to roms.
+    std::vector<RomCandidate> files;
+    // Found but not probed yet. The crawl adds to it and the prober takes from it, both under lock.
+    std::mutex lock;
+    std::condition_variable queued;
+    std::vector<RomProbeJob> queue;
+    bool done = false;
+    // Only the prober touches these until it's joined: the batch being probed, and every result so far by rom index.
+    std::vector<RomProbeJob> probing;
+    std::vector<std::pair<size_t, RomBatchResult>> results;
+};
+
+static void OnRomProbed(void* user, size_t index, const RomBatchResult* result) {
+    RomScan* scan = (RomScan*)user;
+    const RomProbeJob& job = scan->probing[index];
+
+    scan->results.emplace_back(job.rom, *result);
+    if (result->ok) {
+        RomCacheEntry entry = {};
+
+        entry.device = job.file.device;
+        entry.inode = job.file.inode;
+        entry.size = job.file.size;
+        entry.mtime = job.file.mtime;
+        entry.byteOrder = result->byteOrder;
+        entry.verdict = ROM_CACHE_UNKNOWN;
+        memcpy(entry.header, result->header, ROM_HEADER_SIZE);
+        RomCache_Put(scan->cache, &entry);
+    }
+}
+
+// Reads the start of every rom in jobs at once, so GetRomVerCrc works before a rom is loaded. Candidates that aren't
+// in verMap never cost more than this, and roms the cache knows cost nothing.
+static void ProbeRoms(RomScan* scan, std::vector<RomProbeJob>&& jobs) {
+    std::vector<const char*> paths;
+
+    scan->probing.clear();
+    for (RomProbeJob& job : jobs) {
+        const RomCacheEntry* known = RomCache_Find(scan->cache, &job.file);
 
-    do {
-        if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-            char* ext = PathFindExtensionA(ffd.cFileName);
+        if (known != nullptr) {
+            RomBatchResult probe = {};
 
-            // Check for any standard N64 rom file extensions.
-            if ((strcmp(ext, ".z64") == 0) || (strcmp(ext, ".n64") == 0) || (strcmp(ext, ".v64") == 0))
-                roms.push_back(ffd.cFileName);
+            probe.ok = 1;
+            probe.size = known->size;
+            probe.byteOrder = known->byteOrder;
+            memcpy(probe.header, known->header, ROM_HEADER_SIZE);
+            scan->results.emplace_back(job.rom, probe);
+            continue;
         }
-    } while (FindNextFileA(h, &ffd) != 0);
-    // if (h != nullptr) {
-    //    CloseHandle(h);
-    //}
-#elif unix
-    // Open the directory of the app.
-    DIR* d = opendir(".");
-    struct dirent* dir;
-
-    if (d != NULL) {
-        // Go through each file in the directory
-        while ((dir = readdir(d)) != NULL) {
-            struct stat path;
-
-            // Check if current entry is not folder
-            stat(dir->d_name, &path);
-            if (S_ISREG(path.st_mode)) {
-
-                // Get the position of the extension character.
-                char* ext = strchr(dir->d_name, '.');
-                if (ext != NULL && (strcmp(ext, ".z64") == 0) && (strcmp(ext, ".n64") == 0) &&
-                    (strcmp(ext, ".v64") == 0)) {
-                    roms.push_back(dir->d_name);
-                }
+        scan->probing.push_back(std::move(job));
+    }
+    for (const RomProbeJob& job : scan->probing) {
+        paths.push_back(job.path.c_str());
+    }
+    RomBatch_Run(paths.data(), paths.size(), ROM_BATCH_PROBE, FixRomHeader, OnRomProbed, scan);
+}
+
+// Hands every result to probes, now that the number of roms is final.
+static void FinishProbes(RomScan* scan) {
+    scan->probes->assign(scan->roms->size(), RomBatchResult{});
+    for (const auto& [rom, probe] : scan->results) {
+        (*scan->probes)[rom] = probe;
+    }
+    scan->results.clear();
+}
+
+// For roms that were all found up front.
+static void ProbeFoundRoms(RomScan* scan) {
+    std::vector<RomProbeJob> jobs;
+
+    for (size_t i = 0; i < scan->roms->size(); i++) {
+        jobs.push_back({ i, (*scan->roms)[i], scan->files[i] });
+    }
+    ProbeRoms(scan, std::move(jobs));
+    FinishProbes(scan);
+}
+
+// Probes roms while the crawl is still finding more, a queue's worth at a time, the way the crawler batches its
+// sniffs. Returns once the crawl is done, leaving the last partial batch to the caller like the crawler does.
+static void ProbeQueuedRoms(RomScan* scan) {
+    for (;;) {
+        std::vector<RomProbeJob> batch;
+
+        {
+            std::unique_lock<std::mutex> lock(scan->lock);
+
+            scan->queued.wait(lock, [scan]() { return scan->done || scan->queue.size() >= ROM_BATCH_QUEUE_DEPTH; });
+            if (scan->queue.size() < ROM_BATCH_QUEUE_DEPTH) {
+                return;
             }
+            batch.swap(scan->queue);
         }
+        ProbeRoms(scan, std::move(batch));
     }
-    closedir(d);
-#else
-    for (const auto& file : std::filesystem::directory_iterator("./")) {
-        if (file.is_directory())
-            continue;
-        if ((file.path().extension() == ".n64") || (file.path().extension() == ".z64") ||
-            (file.path().extension() == ".v64")) {
-            roms.push_back((file.path()));
+}
+
+static void OnRomFound(void* user, const RomCandidate* candidate) {
+    RomScan* scan = (RomScan*)user;
+    RomProbeJob job = { scan->roms->size(), candidate->path, *candidate };
+
+    // Only queue here. The crawler holds its callback lock during the call, so any I/O would stall every worker
+    // that finds a rom.
+    scan->roms->push_back(candidate->path);
+    scan->files.push_back(*candidate);
+    scan->files.back().path = nullptr;
+    job.file.path = nullptr;
+
+    std::lock_guard<std::mutex> lock(scan->lock);
+    scan->queue.push_back(std::move(job));
+    if (scan->queue.size() == ROM_BATCH_QUEUE_DEPTH) {
+        scan->queued.notify_one();
+    }
+}
+
+void Extractor::GetRoms(std::vector<std::string>& roms, std::vector<RomBatchResult>& probes) {
+    const RomCrawlOptions options = GetRomSearchOptions();
+    RomScan scan;
+    std::thread prober;
+
+    scan.roms = &roms;
+    scan.probes = &probes;
+    scan.cache = mCache;
+
+    // Headers are probed while the crawl goes on, so the two overlap instead of one waiting for the other.
+    try {
+        prober = std::thread(ProbeQueuedRoms, &scan);
+    } catch (const std::system_error&) {
+    }
+    RomDiscovery_Crawl(&options, OnRomFound, &scan);
+    if (prober.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(scan.lock);
+            scan.done = true;
         }
+        scan.queued.notify_one();
+        prober.join();
     }
-#endif
+    // What the prober left, or everything if it couldn't be started.
+    ProbeRoms(&scan, std::move(scan.queue));
+    FinishProbes(&scan);
 }
 
 bool Extractor::GetRomPathFromBox() {
@@ -279,22 +440,65 @@ bool Extractor::GetRomPathFromBox() {
     return true;
 }
 uint32_t Extractor::GetRomVerCrc() {
-    return _byteswap_ulong(((uint32_t*)mRomData.get())[4]);
+    return _byteswap_ulong(((uint32_t*)mRomHeader)[4]);
 }
 
 size_t Extractor::GetCurRomSize() {
     return std::filesystem::file_size(mCurrentRomPath);
 }
 
-bool Extractor::ValidateAndFixRom() {
-    // The MQ debug rom sometimes has the header patched to look like a US rom. Change it ba
-    if (GetRomVerCrc() == OOT_PAL_GC_MQ_DBG) {
-        mRomData[0x3E] = 'P';
+// The MQ debug rom sometimes has the header patched to look like a US rom. Change it back before it is hashed.
+static void FixRomHeader(unsigned char* rom, size_t size) {
+    if (size > 0x3E && _byteswap_ulong(((uint32_t*)rom)[4]) == OOT_PAL_GC_MQ_DBG) {
+        rom[0x3E] = 'P';
+    }
+}
+
+// Streams the current rom off disk, swapping and hashing each chunk while the next one is read. ZAPD reads the rom
+// from disk itself, so nothing but the header is kept.
+bool Extractor::LoadRom() {
+    RomFileHash hash;
+    RomCandidate file;
+    const bool haveIdentity = RomDiscovery_Stat(mCurrentRomPath.c_str(), &file);
+
+    if (haveIdentity) {
+        const RomCacheEntry* known = RomCache_Find(mCache, &file);
+
+        // Hashed by an earlier run and unchanged since, so there's nothing to read.
+        if (known != nullptr && known->verdict != ROM_CACHE_UNKNOWN) {
+            memcpy(mRomHeader, known->header, ROM_HEADER_SIZE);
+            mRomCrc = known->romCrc;
+            return true;
+        }
+    }
+    if (!RomHashFile(mCurrentRomPath.c_str(), FixRomHeader, &hash)) {
+        return false; // TODO Handle error
+    }
+    memcpy(mRomHeader, hash.header, ROM_HEADER_SIZE);
+    mRomCrc = hash.crc;
+    if (sVerbose) {
+        printf("%s: read into %s memory\n", mCurrentRomPath.c_str(), RomBuffer_BackingName(hash.backing));
+    }
+
+    if (haveIdentity) {
+        RomCacheEntry entry = {};
+
+        entry.device = file.device;
+        entry.inode = file.inode;
+        entry.size = file.size;
+        entry.mtime = file.mtime;
+        entry.romCrc = hash.crc;
+        entry.byteOrder = hash.byteOrder;
+        entry.verdict = ValidateRomCrc() ? ROM_CACHE_GOOD : ROM_CACHE_BAD;
+        memcpy(entry.header, hash.header, ROM_HEADER_SIZE);
+        RomCache_Put(mCache, &entry);
     }
-    const uint32_t actualCrc = CRC32C(mRomData.get(), mCurRomSize);
+    return true;
+}
 
+bool Extractor::ValidateRomCrc() {
     for (const uint32_t crc : goodCrcs) {
-        if (actualCrc == crc) {
+        if (mRomCrc == crc) {
             return true;
         }
     }
@@ -313,7 +517,7 @@ bool Extractor::ValidateRom(bool skipCrcTextBox) {
         ShowSizeErrorBox();
         return false;
     }
-    if (!ValidateAndFixRom()) {
+    if (!ValidateRomCrc()) {
         if (!skipCrcTextBox) {
             ShowCrcErrorBox();
         }
@@ -322,12 +526,26 @@ bool Extractor::ValidateRom(bool skipCrcTextBox) {
     return true;
 }
 
+// For roms picked in the file box. Nothing has been read yet, so check the size before loading.
+bool Extractor::LoadAndValidateRom() {
+    if (!ValidateRomSize()) {
+        ShowSizeErrorBox();
+        return false;
+    }
+    if (!LoadRom()) {
+        return false;
+    }
+    return ValidateRom();
+}
+
 bool Extractor::Run() {
     std::vector<std::string> roms;
-    std::ifstream inFile;
+    std::vector<RomBatchResult> probes;
     uint32_t verCrc;
 
-    GetRoms(roms);
+    GetRoms(roms, probes);
+    // The probe buffers have served their purpose. Whatever gets loaded next needs one ring, not a pool of them.
+    RomBuffer_Trim();
 
     if (roms.empty()) {
         int ret = ShowYesNoBox("No roms found", "No roms found. Look for one?");
@@ -339,12 +557,7 @@ bool Extractor::Run() {
                                              nullptr);
                     return false;
                 }
-                inFile.open(mCurrentRomPath, std::ios::in | std::ios::binary);
-                if (!inFile.is_open()) {
-                    return false; // TODO Handle error
-                }
-                inFile.read((char*)mRomData.get(), mCurRomSize);
-                if (!ValidateRom()) {
+                if (!LoadAndValidateRom()) {
                     return false;
                 }
                 break;
@@ -356,20 +569,19 @@ bool Extractor::Run() {
         }
     }
 
-    for (const auto& rom : roms) {
+    for (size_t i = 0; i < roms.size(); i++) {
+        const std::string& rom = roms[i];
         int option;
 
         SetRomInfo(rom);
-        if (inFile.is_open()) {
-            inFile.close();
-        }
-        inFile.open(rom, std::ios::in | std::ios::binary);
         if (!ValidateRomSize()) {
             ShowSizeErrorBox();
             continue;
         }
-        inFile.read((char*)mRomData.get(), mCurRomSize);
-        RomToBigEndian(mRomData.get(), mCurRomSize);
+        if (!probes[i].ok) {
+            continue;
+        }
+        memcpy(mRomHeader, probes[i].header, ROM_HEADER_SIZE);
         verCrc = GetRomVerCrc();
 
         // Rom doesn't claim to be valid
@@ -379,7 +591,7 @@ bool Extractor::Run() {
 
         option = ShowRomPickBox(verCrc);
         if (option == (int)ButtonId::YES) {
-            if (!ValidateRom(true)) {
+            if (!LoadRom() || !ValidateRom(true)) {
                 if (rom == roms.back()) {
                     ShowCrcErrorBox();
                 } else {
@@ -396,17 +608,11 @@ bool Extractor::Run() {
                 // MessageBoxA(nullptr, "No rom selected. Exiting", "No rom selected", MB_OK | MB_ICONERROR);
                 return false;
             }
-            inFile.open(mCurrentRomPath, std::ios::in | std::ios::binary);
-            if (!inFile.is_open()) {
-                return false; // TODO Handle error
-            }
-            inFile.read((char*)mRomData.get(), mCurRomSize);
-            if (!ValidateRom()) {
+            if (!LoadAndValidateRom()) {
                 return false;
             }
             break;
         } else if (option == (int)ButtonId::NO) {
-            inFile.close();
             if (rom == roms.back()) {
                 SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "No rom provided", "No rom provided. Exiting", nullptr);
                 return false;
@@ -418,6 +624,125 @@ bool Extractor::Run() {
     return true;
 }
 
+static void OnWatchedRomHashed(void* user, size_t index, const RomBatchResult* result) {
+    (*(std::vector<RomBatchResult>*)user)[index] = *result;
+}
+
+// Same checks as Run, without the boxes, for everything the watcher found together. Headers are probed as one batch so
+// files that don't claim to be a supported rom are never read in full. The rest are read in full as a second batch,
+// as many at once as ROM_BATCH_MEMORY allows, instead of one after another. The cache is saved once for the batch so a
+// later run doesn't read any of them again either.
+void Extractor::CheckWatchedRoms(const RomCandidate* candidates, size_t count) {
+    std::vector<std::string> roms;
+    std::vector<RomBatchResult> probes;
+    RomScan scan;
+    std::vector<uint32_t> verCrcs(count, 0);
+    // Indexed like candidates. ok is left 0 for files that weren't read in full.
+    std::vector<RomBatchResult> hashes(count);
+    // Whether a file was read in full here rather than known from the cache.
+    std::vector<bool> read(count, false);
+    std::vector<size_t> hashing;
+    std::vector<const char*> hashPaths;
+    std::vector<RomBatchResult> hashed;
+
+    scan.roms = &roms;
+    scan.probes = &probes;
+    scan.cache = mCache;
+    for (size_t i = 0; i < count; i++) {
+        roms.push_back(candidates[i].path);
+        scan.files.push_back(candidates[i]);
+        scan.files.back().path = nullptr;
+    }
+    ProbeFoundRoms(&scan);
+
+    for (size_t i = 0; i < count; i++) {
+        const RomCacheEntry* known;
+
+        if (!probes[i].ok) {
+            continue;
+        }
+        memcpy(mRomHeader, probes[i].header, ROM_HEADER_SIZE);
+        verCrcs[i] = GetRomVerCrc();
+        if (!verMap.contains(verCrcs[i])) {
+            continue;
+        }
+        // Hashed by an earlier run and unchanged since, so there's nothing to read.
+        known = RomCache_Find(mCache, &scan.files[i]);
+        if (known != nullptr && known->verdict != ROM_CACHE_UNKNOWN) {
+            hashes[i].ok = 1;
+            hashes[i].crc = known->romCrc;
+            continue;
+        }
+        hashing.push_back(i);
+        hashPaths.push_back(candidates[i].path);
+    }
+    hashed.resize(hashing.size());
+    RomBatch_Run(hashPaths.data(), hashPaths.size(), ROM_BATCH_FULL, FixRomHeader, OnWatchedRomHashed, &hashed);
+    for (size_t j = 0; j < hashing.size(); j++) {
+        const RomCandidate& file = scan.files[hashing[j]];
+        RomCacheEntry entry = {};
+
+        hashes[hashing[j]] = hashed[j];
+        read[hashing[j]] = true;
+        if (!hashed[j].ok) {
+            continue;
+        }
+        mRomCrc = hashed[j].crc;
+        entry.device = file.device;
+        entry.inode = file.inode;
+        entry.size = file.size;
+        entry.mtime = file.mtime;
+        entry.romCrc = hashed[j].crc;
+        entry.byteOrder = hashed[j].byteOrder;
+        entry.verdict = ValidateRomCrc() ? ROM_CACHE_GOOD : ROM_CACHE_BAD;
+        memcpy(entry.header, hashed[j].header, ROM_HEADER_SIZE);
+        RomCache_Put(mCache, &entry);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char* path = candidates[i].path;
+
+        if (probes[i].ok && !verMap.contains(verCrcs[i])) {
+            printf("%s: not a supported rom\n", path);
+        } else if (!hashes[i].ok) {
+            printf("%s: could not be read\n", path);
+        } else {
+            mRomCrc = hashes[i].crc;
+            printf("%s: %s, %s\n", path, verMap.at(verCrcs[i]),
+                   ValidateRomCrc() ? "CRC good" : "CRC did not match the list of known good roms");
+            if (sVerbose && read[i]) {
+                printf("%s: read into %s memory\n", path, RomBuffer_BackingName(hashes[i].backing));
+            }
+        }
+    }
+    RomCache_Save(mCache);
+}
+
+void Extractor::OnRomWatched(void* user, RomWatchEvent event, const RomCandidate* candidates, size_t count) {
+    Extractor* self = (Extractor*)user;
+
+    switch (event) {
+        case ROM_WATCH_ADDED:
+            self->CheckWatchedRoms(candidates, count);
+            break;
+        case ROM_WATCH_REMOVED:
+            for (size_t i = 0; i < count; i++) {
+                printf("%s: removed\n", candidates[i].path);
+            }
+            break;
+    }
+    fflush(stdout);
+    // The next rom may be hours away. Don't sit on its buffers until then.
+    RomBuffer_Trim();
+}
+
+// Checks the roms already in the search roots, then every rom that lands there until interrupted.
+bool Extractor::Watch() {
+    const RomCrawlOptions options = GetRomSearchOptions();
+
+    return RomWatch_Run(&options, OnRomWatched, this);
+}
+
 bool Extractor::IsMasterQuest() {
     switch (GetRomVerCrc()) {
         case OOT_PAL_GC_MQ_DBG:
@@ -458,8 +783,61 @@ const char* Extractor::GetZapdStr() {
     return zapdCall;
 }
 
-int main() {
+static void ParseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        // Force a CRC32C or byte swap kernel. Mostly useful for benchmarking.
+        if (strcmp(argv[i], "--crc32c-kernel") == 0 && i + 1 < argc) {
+            const Crc32cKernel kernel = CRC32C_KernelFromName(argv[++i]);
+
+            if (!CRC32C_SetKernel(kernel)) {
+                printf("CRC32C kernel %s is not supported on this machine. Using %s\n", argv[i],
+                       CRC32C_KernelName(CRC32C_GetKernel()));
+            }
+        } else if (strcmp(argv[i], "--bswap-kernel") == 0 && i + 1 < argc) {
+            const RomSwapKernel kernel = RomSwap_KernelFromName(argv[++i]);
+
+            if (!RomSwap_SetKernel(kernel)) {
+                printf("Byte swap kernel %s is not supported on this machine. Using %s\n", argv[i],
+                       RomSwap_KernelName(RomSwap_GetKernel()));
+            }
+        } else if (strcmp(argv[i], "--rom-dir") == 0 && i + 1 < argc) {
+            // Search here, recursively, instead of the working directory. May be given more than once.
+            sRomSearch.roots.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            sRomSearch.maxDepth = atoi(argv[++i]);
+            sRomSearch.maxDepthSet = true;
+        } else if (strcmp(argv[i], "--exclude") == 0 && i + 1 < argc) {
+            sRomSearch.excludes.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            sRomSearch.watch = true;
+        } else if (strcmp(argv[i], "--sniff") == 0) {
+            sRomSearch.sniff = true;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            sVerbose = true;
+        } else if (strcmp(argv[i], "--direct-io") == 0) {
+            // Read the rom around the page cache. For bulk validation, where caching it only evicts something else.
+            RomLoader_SetDirectIo(1);
+        }
+    }
+}
+
+static void OnStopSignal(int) {
+    RomWatch_Stop();
+}
+
+int main(int argc, char** argv) {
     Extractor e;
+
+    ParseArgs(argc, argv);
+    if (sRomSearch.watch) {
+        signal(SIGINT, OnStopSignal);
+        signal(SIGTERM, OnStopSignal);
+        if (!e.Watch()) {
+            printf("Watching for roms is not supported here\n");
+            return 1;
+        }
+        return 0;
+    }
     bool valid = e.Run();
     if (valid) {
         const char* zapd = e.GetZapdStr();
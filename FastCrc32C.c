@@ -1,110 +1,654 @@
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
-#ifdef _WIN32
+#include "FastCrc32C.h"
+#include "FastCrc32CTables.h"
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CRC32C_ARCH_X86
 #include <immintrin.h>
-#elif ((defined(__GNUC__) && defined(__x86_64__) || defined(__i386__)) && defined(__SSE4_2__))
-#include <nmmintrin.h>
-#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
-// Nothing cause its a compiler builtin
-#else
-#define USE_CRC_TABLE
+#elif defined(__aarch64__)
+#define CRC32C_ARCH_ARM64
+#include <arm_acle.h>
+#include <arm_neon.h>
 #endif
 
-#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
-#define INTRIN_CRC32_64(crc, value) __asm__("crc32cx %w[c], %w[c], %x[v]" : [c] "+r"(crc) : [v] "r"(value))
-#define INTRIN_CRC32_32(crc, value) __asm__("crc32cw %w[c], %w[c], %w[v]" : [c] "+r"(crc) : [v] "r"(value))
-#define INTRIN_CRC32_16(crc, value) __asm__("crc32ch %w[c], %w[c], %w[v]" : [c] "+r"(crc) : [v] "r"(value))
-#define INTRIN_CRC32_8(crc, value) __asm__("crc32cb %w[c], %w[c], %w[v]" : [c] "+r"(crc) : [v] "r"(value))
-#elif defined(__SSE4_2__) || defined(_MSC_VER)
+#if defined(CRC32C_ARCH_ARM64)
+#define INTRIN_CRC32_64(crc, value) crc = __crc32cd((uint32_t)(crc), (value))
+#define INTRIN_CRC32_32(crc, value) crc = __crc32cw((uint32_t)(crc), (value))
+#define INTRIN_CRC32_16(crc, value) crc = __crc32ch((uint32_t)(crc), (value))
+#define INTRIN_CRC32_8(crc, value) crc = __crc32cb((uint32_t)(crc), (value))
+#elif defined(CRC32C_ARCH_X86)
 #define INTRIN_CRC32_64(crc, data) crc = _mm_crc32_u64(crc, data)
 #define INTRIN_CRC32_32(crc, data) crc = _mm_crc32_u32(crc, data)
 #define INTRIN_CRC32_16(crc, data) crc = _mm_crc32_u16(crc, data)
 #define INTRIN_CRC32_8(crc, data) crc = _mm_crc32_u8(crc, data)
 #endif
 
-#ifdef USE_CRC_TABLE
-static const uint32_t crc32Table[256] = {
-    0x00000000L, 0xF26B8303L, 0xE13B70F7L, 0x1350F3F4L, 0xC79A971FL, 0x35F1141CL, 0x26A1E7E8L, 0xD4CA64EBL, 0x8AD958CFL,
-    0x78B2DBCCL, 0x6BE22838L, 0x9989AB3BL, 0x4D43CFD0L, 0xBF284CD3L, 0xAC78BF27L, 0x5E133C24L, 0x105EC76FL, 0xE235446CL,
-    0xF165B798L, 0x030E349BL, 0xD7C45070L, 0x25AFD373L, 0x36FF2087L, 0xC494A384L, 0x9A879FA0L, 0x68EC1CA3L, 0x7BBCEF57L,
-    0x89D76C54L, 0x5D1D08BFL, 0xAF768BBCL, 0xBC267848L, 0x4E4DFB4BL, 0x20BD8EDEL, 0xD2D60DDDL, 0xC186FE29L, 0x33ED7D2AL,
-    0xE72719C1L, 0x154C9AC2L, 0x061C6936L, 0xF477EA35L, 0xAA64D611L, 0x580F5512L, 0x4B5FA6E6L, 0xB93425E5L, 0x6DFE410EL,
-    0x9F95C20DL, 0x8CC531F9L, 0x7EAEB2FAL, 0x30E349B1L, 0xC288CAB2L, 0xD1D83946L, 0x23B3BA45L, 0xF779DEAEL, 0x05125DADL,
-    0x1642AE59L, 0xE4292D5AL, 0xBA3A117EL, 0x4851927DL, 0x5B016189L, 0xA96AE28AL, 0x7DA08661L, 0x8FCB0562L, 0x9C9BF696L,
-    0x6EF07595L, 0x417B1DBCL, 0xB3109EBFL, 0xA0406D4BL, 0x522BEE48L, 0x86E18AA3L, 0x748A09A0L, 0x67DAFA54L, 0x95B17957L,
-    0xCBA24573L, 0x39C9C670L, 0x2A993584L, 0xD8F2B687L, 0x0C38D26CL, 0xFE53516FL, 0xED03A29BL, 0x1F682198L, 0x5125DAD3L,
-    0xA34E59D0L, 0xB01EAA24L, 0x42752927L, 0x96BF4DCCL, 0x64D4CECFL, 0x77843D3BL, 0x85EFBE38L, 0xDBFC821CL, 0x2997011FL,
-    0x3AC7F2EBL, 0xC8AC71E8L, 0x1C661503L, 0xEE0D9600L, 0xFD5D65F4L, 0x0F36E6F7L, 0x61C69362L, 0x93AD1061L, 0x80FDE395L,
-    0x72966096L, 0xA65C047DL, 0x5437877EL, 0x4767748AL, 0xB50CF789L, 0xEB1FCBADL, 0x197448AEL, 0x0A24BB5AL, 0xF84F3859L,
-    0x2C855CB2L, 0xDEEEDFB1L, 0xCDBE2C45L, 0x3FD5AF46L, 0x7198540DL, 0x83F3D70EL, 0x90A324FAL, 0x62C8A7F9L, 0xB602C312L,
-    0x44694011L, 0x5739B3E5L, 0xA55230E6L, 0xFB410CC2L, 0x092A8FC1L, 0x1A7A7C35L, 0xE811FF36L, 0x3CDB9BDDL, 0xCEB018DEL,
-    0xDDE0EB2AL, 0x2F8B6829L, 0x82F63B78L, 0x709DB87BL, 0x63CD4B8FL, 0x91A6C88CL, 0x456CAC67L, 0xB7072F64L, 0xA457DC90L,
-    0x563C5F93L, 0x082F63B7L, 0xFA44E0B4L, 0xE9141340L, 0x1B7F9043L, 0xCFB5F4A8L, 0x3DDE77ABL, 0x2E8E845FL, 0xDCE5075CL,
-    0x92A8FC17L, 0x60C37F14L, 0x73938CE0L, 0x81F80FE3L, 0x55326B08L, 0xA759E80BL, 0xB4091BFFL, 0x466298FCL, 0x1871A4D8L,
-    0xEA1A27DBL, 0xF94AD42FL, 0x0B21572CL, 0xDFEB33C7L, 0x2D80B0C4L, 0x3ED04330L, 0xCCBBC033L, 0xA24BB5A6L, 0x502036A5L,
-    0x4370C551L, 0xB11B4652L, 0x65D122B9L, 0x97BAA1BAL, 0x84EA524EL, 0x7681D14DL, 0x2892ED69L, 0xDAF96E6AL, 0xC9A99D9EL,
-    0x3BC21E9DL, 0xEF087A76L, 0x1D63F975L, 0x0E330A81L, 0xFC588982L, 0xB21572C9L, 0x407EF1CAL, 0x532E023EL, 0xA145813DL,
-    0x758FE5D6L, 0x87E466D5L, 0x94B49521L, 0x66DF1622L, 0x38CC2A06L, 0xCAA7A905L, 0xD9F75AF1L, 0x2B9CD9F2L, 0xFF56BD19L,
-    0x0D3D3E1AL, 0x1E6DCDEEL, 0xEC064EEDL, 0xC38D26C4L, 0x31E6A5C7L, 0x22B65633L, 0xD0DDD530L, 0x0417B1DBL, 0xF67C32D8L,
-    0xE52CC12CL, 0x1747422FL, 0x49547E0BL, 0xBB3FFD08L, 0xA86F0EFCL, 0x5A048DFFL, 0x8ECEE914L, 0x7CA56A17L, 0x6FF599E3L,
-    0x9D9E1AE0L, 0xD3D3E1ABL, 0x21B862A8L, 0x32E8915CL, 0xC083125FL, 0x144976B4L, 0xE622F5B7L, 0xF5720643L, 0x07198540L,
-    0x590AB964L, 0xAB613A67L, 0xB831C993L, 0x4A5A4A90L, 0x9E902E7BL, 0x6CFBAD78L, 0x7FAB5E8CL, 0x8DC0DD8FL, 0xE330A81AL,
-    0x115B2B19L, 0x020BD8EDL, 0xF0605BEEL, 0x24AA3F05L, 0xD6C1BC06L, 0xC5914FF2L, 0x37FACCF1L, 0x69E9F0D5L, 0x9B8273D6L,
-    0x88D28022L, 0x7AB90321L, 0xAE7367CAL, 0x5C18E4C9L, 0x4F48173DL, 0xBD23943EL, 0xF36E6F75L, 0x0105EC76L, 0x12551F82L,
-    0xE03E9C81L, 0x34F4F86AL, 0xC69F7B69L, 0xD5CF889DL, 0x27A40B9EL, 0x79B737BAL, 0x8BDCB4B9L, 0x988C474DL, 0x6AE7C44EL,
-    0xBE2DA0A5L, 0x4C4623A6L, 0x5F16D052L, 0xAD7D5351L
-};
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_ATTR(features) __attribute__((target(features)))
+#else
+#define TARGET_ATTR(features)
+#endif
+
+// Each hardware kernel is compiled for its own instruction set with a target attribute and only bound once the CPU
+// has been checked, so the file itself builds for the baseline ISA.
+#if defined(CRC32C_ARCH_X86)
+#define CRC32C_HW_TARGET "sse4.2"
+#elif defined(CRC32C_ARCH_ARM64)
+#define CRC32C_HW_TARGET "+crc"
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32C_HAVE_CLMUL
+#endif
+
+#if defined(CRC32C_ARCH_ARM64)
+#define CRC32C_HAVE_PMULL
 #endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#ifndef USE_CRC_TABLE
-uint32_t CRC32C(unsigned char* data, size_t dataSize) {
-    uint32_t ret = 0xFFFFFFFF;
+// Reflected CRC32C polynomial. Used when shifting a CRC register past a run of zero bytes.
+#define CRC32C_POLY 0x82F63B78
+
+// Lane sizes for the interleaved kernel. The long lanes cover the bulk of a ROM, the short lanes pick up what is left
+// before the serial loop finishes the last few hundred bytes.
+#define CRC32C_LONG_LANE 8192
+#define CRC32C_SHORT_LANE 256
+
+// x^(8 * lane size) mod P, precomputed for each lane size. Multiplying a CRC register by one of these is the same as
+// feeding it a whole lane of zero bytes.
+#define CRC32C_LONG_SHIFT 0x28461564
+#define CRC32C_SHORT_SHIFT 0x88E56F72
+
+#define CRC32C_LOAD_LE32(p) \
+    ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+// Slicing-by-16 table loop. Looks up all 16 bytes of a block in parallel tables, so the only dependency between
+// iterations is the final xor. The fallback for CPUs without a crc32 instruction.
+static uint32_t Crc32cSlice16(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    const uint32_t(*t)[256] = crc32cSliceTables.slice;
+
+    while (dataSize >= 16) {
+        const uint32_t a = CRC32C_LOAD_LE32(data) ^ crc;
+        const uint32_t b = CRC32C_LOAD_LE32(data + 4);
+        const uint32_t c = CRC32C_LOAD_LE32(data + 8);
+        const uint32_t d = CRC32C_LOAD_LE32(data + 12);
+
+        crc = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24] ^
+              t[11][b & 0xFF] ^ t[10][(b >> 8) & 0xFF] ^ t[9][(b >> 16) & 0xFF] ^ t[8][b >> 24] ^
+              t[7][c & 0xFF] ^ t[6][(c >> 8) & 0xFF] ^ t[5][(c >> 16) & 0xFF] ^ t[4][c >> 24] ^
+              t[3][d & 0xFF] ^ t[2][(d >> 8) & 0xFF] ^ t[1][(d >> 16) & 0xFF] ^ t[0][d >> 24];
+        data += 16;
+        dataSize -= 16;
+    }
+
+    while (dataSize--)
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+// Multiply a and b modulo P. Both are reflected, so x^0 is 0x80000000.
+static uint32_t Crc32cMultModP(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+// x^(8 * n) mod P. A byte is 2^3 bits, so the walk through the x^(2^k) table starts at k = 3.
+static uint32_t Crc32cX8nModP(uint64_t n) {
+    uint32_t p = 1u << 31;
+    unsigned k = 3;
+
+    while (n) {
+        if (n & 1) {
+            p = Crc32cMultModP(crc32cX2nTable.x2n[k % 31], p);
+        }
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+#ifdef CRC32C_HW_TARGET
+// Serial loop. One dependent crc32 chain, so it runs at one word per instruction latency.
+TARGET_ATTR(CRC32C_HW_TARGET)
+static uint32_t Crc32cSerial(uint32_t crc, const unsigned char* data, size_t dataSize) {
     int64_t sizeSigned = dataSize;
 
 #if defined(_M_X64) || defined(__x86_64__) || defined(__aarch64__)
     while ((sizeSigned -= sizeof(uint64_t)) >= 0) {
-        INTRIN_CRC32_64(ret, *(uint64_t*)data);
+        INTRIN_CRC32_64(crc, *(uint64_t*)data);
         data += sizeof(uint64_t);
     }
 
     if (sizeSigned & sizeof(uint32_t)) {
-        INTRIN_CRC32_32(ret, *(uint32_t*)data);
+        INTRIN_CRC32_32(crc, *(uint32_t*)data);
 
         data += sizeof(uint32_t);
     }
 #elif defined(_M_IX86) || defined(__i386__)
     while ((sizeSigned -= sizeof(uint32_t)) >= 0) {
-        INTRIN_CRC32_32(ret, *(uint32_t*)data);
+        INTRIN_CRC32_32(crc, *(uint32_t*)data);
         data += sizeof(uint32_t);
     }
 #endif
     if (sizeSigned & sizeof(uint16_t)) {
-        INTRIN_CRC32_16(ret, *(uint16_t*)data);
+        INTRIN_CRC32_16(crc, *(uint16_t*)data);
         data += sizeof(uint16_t);
     }
 
     if (sizeSigned & sizeof(uint8_t)) {
-        INTRIN_CRC32_8(ret, *data);
+        INTRIN_CRC32_8(crc, *data);
+    }
+
+    return crc;
+}
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__aarch64__)
+// Runs three independent crc32 chains over three adjacent lanes. The instruction has a latency of about three cycles
+// but a throughput of one per cycle, so three chains keep the unit busy. The lanes are merged by shifting the earlier
+// lanes past the later ones: crc(A || B) = crc(A) * x^(8 * len(B)) ^ crc(B), with the second term started from zero.
+TARGET_ATTR(CRC32C_HW_TARGET)
+static uint32_t Crc32c3WayLanes(uint32_t crc, const unsigned char** pData, size_t* pSize, size_t lane, uint32_t shift) {
+    const unsigned char* data = *pData;
+    size_t size = *pSize;
+
+    while (size >= lane * 3) {
+        uint64_t crc0 = crc;
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        const unsigned char* end = data + lane;
+
+        do {
+            INTRIN_CRC32_64(crc0, *(uint64_t*)data);
+            INTRIN_CRC32_64(crc1, *(uint64_t*)(data + lane));
+            INTRIN_CRC32_64(crc2, *(uint64_t*)(data + lane * 2));
+            data += sizeof(uint64_t);
+        } while (data < end);
+
+        crc = Crc32cMultModP(shift, (uint32_t)crc0) ^ (uint32_t)crc1;
+        crc = Crc32cMultModP(shift, crc) ^ (uint32_t)crc2;
+        data += lane * 2;
+        size -= lane * 3;
     }
 
-    return ~ret;
+    *pData = data;
+    *pSize = size;
+    return crc;
+}
+
+TARGET_ATTR(CRC32C_HW_TARGET)
+static uint32_t Crc32c3Way(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    crc = Crc32c3WayLanes(crc, &data, &dataSize, CRC32C_LONG_LANE, CRC32C_LONG_SHIFT);
+    crc = Crc32c3WayLanes(crc, &data, &dataSize, CRC32C_SHORT_LANE, CRC32C_SHORT_SHIFT);
+    return Crc32cSerial(crc, data, dataSize);
+}
+#else
+// No 64 bit crc32 instruction to interleave. Fall back to the serial loop.
+#define Crc32c3Way Crc32cSerial
+#endif
+
+#if defined(CRC32C_HAVE_CLMUL) || defined(CRC32C_HAVE_PMULL)
+// Folding constants for carry-less multiply kernels. Folding a 128 bit block forward by D bits multiplies its low
+// half by x^(D + 32) mod P and its high half by x^(D - 32) mod P, both shifted left by one for the reflected
+// representation. The low constant goes in the low qword.
+#define CRC32C_FOLD_128_LO 0xF20C0DFE
+#define CRC32C_FOLD_128_HI 0x14CD00BD6
+#define CRC32C_FOLD_512_LO 0x740EEF02
+#define CRC32C_FOLD_512_HI 0x9E4ADDF8
+#define CRC32C_FOLD_2048_LO 0xDCB17AA4
+#define CRC32C_FOLD_2048_HI 0xB9E02B86
+#endif
+
+#ifdef CRC32C_HAVE_CLMUL
+TARGET_ATTR("sse4.2,pclmul")
+static inline __m128i Crc32cFold128(__m128i acc, __m128i data, __m128i k) {
+    __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), data);
+}
+
+// A folded 128 bit remainder has the same CRC as the data it replaced, so the crc32 instruction can finish the job
+// from a zero register.
+TARGET_ATTR("sse4.2,pclmul")
+static inline uint32_t Crc32cReduce128(__m128i acc) {
+    uint64_t crc = 0;
+
+    INTRIN_CRC32_64(crc, (uint64_t)_mm_cvtsi128_si64(acc));
+    INTRIN_CRC32_64(crc, (uint64_t)_mm_extract_epi64(acc, 1));
+    return (uint32_t)crc;
+}
+
+// Folds 64 bytes per iteration with PCLMULQDQ across four accumulators, then collapses them to one and lets the
+// serial loop handle the last few bytes. The incoming register is xored into the first four bytes of data.
+TARGET_ATTR("sse4.2,pclmul")
+static uint32_t Crc32cPclmul(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    const __m128i k512 = _mm_set_epi64x(CRC32C_FOLD_512_HI, CRC32C_FOLD_512_LO);
+    const __m128i k128 = _mm_set_epi64x(CRC32C_FOLD_128_HI, CRC32C_FOLD_128_LO);
+    __m128i x0, x1, x2, x3;
+
+    if (dataSize < 128) {
+        return Crc32c3Way(crc, data, dataSize);
+    }
+
+    x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)data), _mm_cvtsi32_si128((int)crc));
+    x1 = _mm_loadu_si128((const __m128i*)(data + 16));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 32));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 48));
+    data += 64;
+    dataSize -= 64;
+
+    while (dataSize >= 64) {
+        x0 = Crc32cFold128(x0, _mm_loadu_si128((const __m128i*)data), k512);
+        x1 = Crc32cFold128(x1, _mm_loadu_si128((const __m128i*)(data + 16)), k512);
+        x2 = Crc32cFold128(x2, _mm_loadu_si128((const __m128i*)(data + 32)), k512);
+        x3 = Crc32cFold128(x3, _mm_loadu_si128((const __m128i*)(data + 48)), k512);
+        data += 64;
+        dataSize -= 64;
+    }
+
+    x0 = Crc32cFold128(x0, x1, k128);
+    x0 = Crc32cFold128(x0, x2, k128);
+    x0 = Crc32cFold128(x0, x3, k128);
+
+    while (dataSize >= 16) {
+        x0 = Crc32cFold128(x0, _mm_loadu_si128((const __m128i*)data), k128);
+        data += 16;
+        dataSize -= 16;
+    }
+
+    return Crc32cSerial(Crc32cReduce128(x0), data, dataSize);
+}
+
+TARGET_ATTR("sse4.2,pclmul,avx512f,vpclmulqdq")
+static inline __m512i Crc32cFold512(__m512i acc, __m512i data, __m512i k) {
+    __m512i lo = _mm512_clmulepi64_epi128(acc, k, 0x00);
+    __m512i hi = _mm512_clmulepi64_epi128(acc, k, 0x11);
+
+    return _mm512_ternarylogic_epi64(lo, hi, data, 0x96);
+}
+
+// Same scheme as the PCLMULQDQ kernel with four 512 bit accumulators, so each step folds 256 bytes. The accumulators
+// are collapsed to one zmm register and then lane by lane down to the 128 bit remainder.
+TARGET_ATTR("sse4.2,pclmul,avx512f,vpclmulqdq")
+static uint32_t Crc32cVpclmul(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    const __m512i k2048 = _mm512_broadcast_i32x4(_mm_set_epi64x(CRC32C_FOLD_2048_HI, CRC32C_FOLD_2048_LO));
+    const __m512i k512 = _mm512_broadcast_i32x4(_mm_set_epi64x(CRC32C_FOLD_512_HI, CRC32C_FOLD_512_LO));
+    const __m128i k128 = _mm_set_epi64x(CRC32C_FOLD_128_HI, CRC32C_FOLD_128_LO);
+    __m512i z0, z1, z2, z3;
+    __m128i x0;
+
+    if (dataSize < 512) {
+        return Crc32cPclmul(crc, data, dataSize);
+    }
+
+    z0 = _mm512_xor_si512(_mm512_loadu_si512(data), _mm512_castsi128_si512(_mm_cvtsi32_si128((int)crc)));
+    z1 = _mm512_loadu_si512(data + 64);
+    z2 = _mm512_loadu_si512(data + 128);
+    z3 = _mm512_loadu_si512(data + 192);
+    data += 256;
+    dataSize -= 256;
+
+    while (dataSize >= 256) {
+        z0 = Crc32cFold512(z0, _mm512_loadu_si512(data), k2048);
+        z1 = Crc32cFold512(z1, _mm512_loadu_si512(data + 64), k2048);
+        z2 = Crc32cFold512(z2, _mm512_loadu_si512(data + 128), k2048);
+        z3 = Crc32cFold512(z3, _mm512_loadu_si512(data + 192), k2048);
+        data += 256;
+        dataSize -= 256;
+    }
+
+    z0 = Crc32cFold512(z0, z1, k512);
+    z0 = Crc32cFold512(z0, z2, k512);
+    z0 = Crc32cFold512(z0, z3, k512);
+
+    while (dataSize >= 64) {
+        z0 = Crc32cFold512(z0, _mm512_loadu_si512(data), k512);
+        data += 64;
+        dataSize -= 64;
+    }
+
+    x0 = _mm512_extracti32x4_epi32(z0, 0);
+    x0 = Crc32cFold128(x0, _mm512_extracti32x4_epi32(z0, 1), k128);
+    x0 = Crc32cFold128(x0, _mm512_extracti32x4_epi32(z0, 2), k128);
+    x0 = Crc32cFold128(x0, _mm512_extracti32x4_epi32(z0, 3), k128);
+
+    while (dataSize >= 16) {
+        x0 = Crc32cFold128(x0, _mm_loadu_si128((const __m128i*)data), k128);
+        data += 16;
+        dataSize -= 16;
+    }
+
+    return Crc32cSerial(Crc32cReduce128(x0), data, dataSize);
+}
+#endif
+
+#ifdef CRC32C_HAVE_PMULL
+TARGET_ATTR("+crc+crypto")
+static inline uint64x2_t Crc32cFoldPmull(uint64x2_t acc, uint64x2_t data, uint64x2_t k) {
+    uint64x2_t lo =
+        vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(acc, 0), (poly64_t)vgetq_lane_u64(k, 0)));
+    uint64x2_t hi = vreinterpretq_u64_p128(vmull_high_p64(vreinterpretq_p64_u64(acc), vreinterpretq_p64_u64(k)));
+
+    return veorq_u64(veorq_u64(lo, hi), data);
+}
+
+// Same fold with the two xors merged into one EOR3. Needs the SHA3 extension.
+TARGET_ATTR("+crc+crypto+sha3")
+static inline uint64x2_t Crc32cFoldPmullEor3(uint64x2_t acc, uint64x2_t data, uint64x2_t k) {
+    uint64x2_t lo =
+        vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(acc, 0), (poly64_t)vgetq_lane_u64(k, 0)));
+    uint64x2_t hi = vreinterpretq_u64_p128(vmull_high_p64(vreinterpretq_p64_u64(acc), vreinterpretq_p64_u64(k)));
+
+    return veor3q_u64(lo, hi, data);
 }
+
+#define CRC32C_LOAD_NEON(p) vreinterpretq_u64_u8(vld1q_u8(p))
+
+// The body of the PMULL kernels. It mirrors the PCLMULQDQ kernel: four 128 bit accumulators fold 64 bytes per step,
+// then collapse to one and the crc32cx loop finishes. FOLD picks between the plain and the EOR3 fold helper.
+#define CRC32C_PMULL_BODY(FOLD)                                                                             \
+    const uint64x2_t k512 = vcombine_u64(vcreate_u64(CRC32C_FOLD_512_LO), vcreate_u64(CRC32C_FOLD_512_HI)); \
+    const uint64x2_t k128 = vcombine_u64(vcreate_u64(CRC32C_FOLD_128_LO), vcreate_u64(CRC32C_FOLD_128_HI)); \
+    uint64x2_t x0, x1, x2, x3;                                                                              \
+    uint64_t reduced = 0;                                                                                   \
+                                                                                                            \
+    if (dataSize < 128) {                                                                                   \
+        return Crc32c3Way(crc, data, dataSize);                                                             \
+    }                                                                                                       \
+                                                                                                            \
+    x0 = veorq_u64(CRC32C_LOAD_NEON(data), vsetq_lane_u64((uint64_t)crc, vdupq_n_u64(0), 0));               \
+    x1 = CRC32C_LOAD_NEON(data + 16);                                                                       \
+    x2 = CRC32C_LOAD_NEON(data + 32);                                                                       \
+    x3 = CRC32C_LOAD_NEON(data + 48);                                                                       \
+    data += 64;                                                                                             \
+    dataSize -= 64;                                                                                         \
+                                                                                                            \
+    while (dataSize >= 64) {                                                                                \
+        x0 = FOLD(x0, CRC32C_LOAD_NEON(data), k512);                                                        \
+        x1 = FOLD(x1, CRC32C_LOAD_NEON(data + 16), k512);                                                   \
+        x2 = FOLD(x2, CRC32C_LOAD_NEON(data + 32), k512);                                                   \
+        x3 = FOLD(x3, CRC32C_LOAD_NEON(data + 48), k512);                                                   \
+        data += 64;                                                                                         \
+        dataSize -= 64;                                                                                     \
+    }                                                                                                       \
+                                                                                                            \
+    x0 = FOLD(x0, x1, k128);                                                                                \
+    x0 = FOLD(x0, x2, k128);                                                                                \
+    x0 = FOLD(x0, x3, k128);                                                                                \
+                                                                                                            \
+    while (dataSize >= 16) {                                                                                \
+        x0 = FOLD(x0, CRC32C_LOAD_NEON(data), k128);                                                        \
+        data += 16;                                                                                         \
+        dataSize -= 16;                                                                                     \
+    }                                                                                                       \
+                                                                                                            \
+    INTRIN_CRC32_64(reduced, vgetq_lane_u64(x0, 0));                                                        \
+    INTRIN_CRC32_64(reduced, vgetq_lane_u64(x0, 1));                                                        \
+    return Crc32cSerial((uint32_t)reduced, data, dataSize)
+
+TARGET_ATTR("+crc+crypto")
+static uint32_t Crc32cPmull(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    CRC32C_PMULL_BODY(Crc32cFoldPmull);
+}
+
+TARGET_ATTR("+crc+crypto+sha3")
+static uint32_t Crc32cPmullEor3(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    CRC32C_PMULL_BODY(Crc32cFoldPmullEor3);
+}
+#endif
+
+#endif
+
+typedef uint32_t (*Crc32cKernelFn)(uint32_t crc, const unsigned char* data, size_t dataSize);
+
+typedef struct Crc32cKernelInfo {
+    const char* name;
+    Crc32cKernelFn fn;
+    uint32_t cpuFeatures;
+} Crc32cKernelInfo;
+
+// Indexed by Crc32cKernel. Kernels that can't be built for this architecture have no function.
+static const Crc32cKernelInfo sCrc32cKernels[CRC32C_KERNEL_COUNT] = {
+    { "auto", NULL, 0 },
+    { "slice16", Crc32cSlice16, 0 },
+#if defined(CRC32C_ARCH_X86)
+    { "serial", Crc32cSerial, CPU_FEATURE_SSE42 },
+    { "3way", Crc32c3Way, CPU_FEATURE_SSE42 },
+#elif defined(CRC32C_ARCH_ARM64)
+    { "serial", Crc32cSerial, CPU_FEATURE_ARM_CRC32 },
+    { "3way", Crc32c3Way, CPU_FEATURE_ARM_CRC32 },
 #else
-uint32_t CRC32C(const void* buf, size_t size) {
-    const uint8_t* p = buf;
-    uint32_t crc = 0xFFFFFFFF;
+    { "serial", NULL, 0 },
+    { "3way", NULL, 0 },
+#endif
+#ifdef CRC32C_HAVE_CLMUL
+    { "pclmul", Crc32cPclmul, CPU_FEATURE_SSE42 | CPU_FEATURE_PCLMUL },
+    { "vpclmul", Crc32cVpclmul, CPU_FEATURE_SSE42 | CPU_FEATURE_PCLMUL | CPU_FEATURE_AVX512F | CPU_FEATURE_VPCLMUL },
+#else
+    { "pclmul", NULL, 0 },
+    { "vpclmul", NULL, 0 },
+#endif
+#ifdef CRC32C_HAVE_PMULL
+    { "pmull", Crc32cPmull, CPU_FEATURE_ARM_CRC32 | CPU_FEATURE_ARM_PMULL },
+    { "pmull-eor3", Crc32cPmullEor3, CPU_FEATURE_ARM_CRC32 | CPU_FEATURE_ARM_PMULL | CPU_FEATURE_ARM_SHA3 },
+#else
+    { "pmull", NULL, 0 },
+    { "pmull-eor3", NULL, 0 },
+#endif
+};
+
+// Preference order when picking a kernel automatically. The slicing kernel always works, so it ends the list.
+static const Crc32cKernel sCrc32cPreference[] = {
+    CRC32C_KERNEL_VPCLMUL, CRC32C_KERNEL_PCLMUL, CRC32C_KERNEL_PMULL_EOR3, CRC32C_KERNEL_PMULL,
+    CRC32C_KERNEL_3WAY,    CRC32C_KERNEL_SLICE16,
+};
+
+static uint32_t Crc32cResolve(uint32_t crc, const unsigned char* data, size_t dataSize);
+
+// Starts out pointing at the resolver, which replaces itself with the real kernel on the first call. Every thread
+// that races through the resolver sees the same features and picks the same kernel, so any of their stores will do.
+static Crc32cKernelFn volatile sCrc32cImpl = Crc32cResolve;
+static volatile Crc32cKernel sCrc32cKernel = CRC32C_KERNEL_AUTO;
+
+int CRC32C_KernelSupported(Crc32cKernel kernel) {
+    if (kernel <= CRC32C_KERNEL_AUTO || kernel >= CRC32C_KERNEL_COUNT || sCrc32cKernels[kernel].fn == NULL) {
+        return 0;
+    }
+    return (GetCpuFeatures() & sCrc32cKernels[kernel].cpuFeatures) == sCrc32cKernels[kernel].cpuFeatures;
+}
+
+const char* CRC32C_KernelName(Crc32cKernel kernel) {
+    if (kernel < CRC32C_KERNEL_AUTO || kernel >= CRC32C_KERNEL_COUNT) {
+        return NULL;
+    }
+    return sCrc32cKernels[kernel].name;
+}
+
+Crc32cKernel CRC32C_KernelFromName(const char* name) {
+    for (int i = 0; i < CRC32C_KERNEL_COUNT; i++) {
+        if (strcmp(name, sCrc32cKernels[i].name) == 0) {
+            return (Crc32cKernel)i;
+        }
+    }
+    return CRC32C_KERNEL_COUNT;
+}
+
+Crc32cKernel CRC32C_GetKernel(void) {
+    if (CPU_DISPATCH_LOAD(&sCrc32cKernel) == CRC32C_KERNEL_AUTO) {
+        CRC32C_SetKernel(CRC32C_KERNEL_AUTO);
+    }
+    return CPU_DISPATCH_LOAD(&sCrc32cKernel);
+}
 
-    while (size--)
-        crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+int CRC32C_SetKernel(Crc32cKernel kernel) {
+    if (kernel == CRC32C_KERNEL_AUTO) {
+        const char* forced = getenv(CRC32C_KERNEL_ENV);
 
-    return ~crc;
+        if (forced != NULL && CRC32C_KernelSupported(CRC32C_KernelFromName(forced))) {
+            kernel = CRC32C_KernelFromName(forced);
+        } else {
+            for (size_t i = 0; i < sizeof(sCrc32cPreference) / sizeof(sCrc32cPreference[0]); i++) {
+                if (CRC32C_KernelSupported(sCrc32cPreference[i])) {
+                    kernel = sCrc32cPreference[i];
+                    break;
+                }
+            }
+        }
+    } else if (!CRC32C_KernelSupported(kernel)) {
+        return 0;
+    }
+
+    CPU_DISPATCH_STORE(&sCrc32cKernel, kernel);
+    CPU_DISPATCH_STORE(&sCrc32cImpl, sCrc32cKernels[kernel].fn);
+    return 1;
 }
+
+static uint32_t Crc32cResolve(uint32_t crc, const unsigned char* data, size_t dataSize) {
+    CRC32C_SetKernel(CRC32C_KERNEL_AUTO);
+    return CPU_DISPATCH_LOAD(&sCrc32cImpl)(crc, data, dataSize);
+}
+
+uint32_t CRC32C(unsigned char* data, size_t dataSize) {
+    return ~CPU_DISPATCH_LOAD(&sCrc32cImpl)(0xFFFFFFFF, data, dataSize);
+}
+
+void CRC32C_Init(Crc32cState* state) {
+    state->crc = 0xFFFFFFFF;
+    state->length = 0;
+}
+
+void CRC32C_Update(Crc32cState* state, const void* data, size_t dataSize) {
+    // Every kernel takes and returns the raw register, so chunks can be fed in at any size and alignment.
+    state->crc = CPU_DISPATCH_LOAD(&sCrc32cImpl)(state->crc, (const unsigned char*)data, dataSize);
+    state->length += dataSize;
+}
+
+uint32_t CRC32C_Final(const Crc32cState* state) {
+    return ~state->crc;
+}
+
+uint32_t CRC32C_Shift(uint32_t crc, uint64_t length) {
+    return Crc32cMultModP(Crc32cX8nModP(length), crc);
+}
+
+uint32_t CRC32C_Combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB) {
+    // The pre and post inversions of A and B cancel out, so finished CRCs combine the same way raw registers do.
+    return CRC32C_Shift(crcA, lengthB) ^ crcB;
+}
+
+// Feeds count copies of value into a raw register without touching memory. With R(n) the register a zero seed ends
+// up with after n copies and X(n) = x^(8n), R(2n) = X(n) * R(n) ^ R(n) and R(n + 1) = x^8 * R(n) ^ R(1), so walking
+// the bits of count from the top takes O(log count) multiplies.
+static uint32_t Crc32cRunRegister(uint32_t crc, unsigned char value, uint64_t count) {
+    const uint32_t x8 = crc32cX2nTable.x2n[3];
+    const uint32_t r1 = crc32cSliceTables.slice[0][value];
+    uint32_t r = 0;
+    uint32_t xn = 1u << 31;
+    int bit = 63;
+
+    while (bit >= 0 && !(count >> bit & 1)) {
+        bit--;
+    }
+    for (; bit >= 0; bit--) {
+        r = Crc32cMultModP(xn, r) ^ r;
+        xn = Crc32cMultModP(xn, xn);
+        if (count >> bit & 1) {
+            r = Crc32cMultModP(x8, r) ^ r1;
+            xn = Crc32cMultModP(x8, xn);
+        }
+    }
+    return Crc32cMultModP(xn, crc) ^ r;
+}
+
+void CRC32C_UpdateRun(Crc32cState* state, unsigned char value, uint64_t count) {
+    state->crc = Crc32cRunRegister(state->crc, value, count);
+    state->length += count;
+}
+
+uint32_t CRC32C_ExtendRun(uint32_t crc, unsigned char value, uint64_t count) {
+    return ~Crc32cRunRegister(~crc, value, count);
+}
+
+size_t CRC32C_TrailingRunLength(const unsigned char* data, size_t dataSize) {
+    const unsigned char* end = data + dataSize;
+    const unsigned char* p = end;
+    unsigned char value;
+
+    if (dataSize == 0) {
+        return 0;
+    }
+    value = end[-1];
+
+    // Compare whole 64 byte blocks until one has a different byte in it, then let the byte loop find where.
+#if defined(_M_X64) || defined(__x86_64__)
+    {
+        const __m128i fill = _mm_set1_epi8((char)value);
+
+        while (p - data >= 64) {
+            __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p - 64)), fill);
+            __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p - 48)), fill);
+            __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p - 32)), fill);
+            __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p - 16)), fill);
+
+            if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))) != 0xFFFF) {
+                break;
+            }
+            p -= 64;
+        }
+    }
+#elif defined(CRC32C_ARCH_ARM64)
+    {
+        const uint8x16_t fill = vdupq_n_u8(value);
+
+        while (p - data >= 64) {
+            uint8x16_t a = vceqq_u8(vld1q_u8(p - 64), fill);
+            uint8x16_t b = vceqq_u8(vld1q_u8(p - 48), fill);
+            uint8x16_t c = vceqq_u8(vld1q_u8(p - 32), fill);
+            uint8x16_t d = vceqq_u8(vld1q_u8(p - 16), fill);
+
+            if (vminvq_u8(vandq_u8(vandq_u8(a, b), vandq_u8(c, d))) != 0xFF) {
+                break;
+            }
+            p -= 64;
+        }
+    }
 #endif
+
+    while (p > data && p[-1] == value) {
+        p--;
+    }
+    return (size_t)(end - p);
+}
+
+uint32_t CRC32C_SkipPadding(const unsigned char* data, size_t dataSize) {
+    const size_t padding = CRC32C_TrailingRunLength(data, dataSize);
+
+    if (padding < CRC32C_MIN_PADDING) {
+        return CRC32C_Parallel(data, dataSize, 0);
+    }
+    return CRC32C_ExtendRun(CRC32C_Parallel(data, dataSize - padding, 0), data[dataSize - 1], padding);
+}
 #ifdef __cplusplus
 }
 #endif
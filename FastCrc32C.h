@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Environment variable that forces a kernel by name, e.g. OTR_CRC32C_KERNEL=3way. Ignored if the CPU can't run it.
+#define CRC32C_KERNEL_ENV "OTR_CRC32C_KERNEL"
+
+typedef enum Crc32cKernel {
+    CRC32C_KERNEL_AUTO,
+    CRC32C_KERNEL_SLICE16,
+    CRC32C_KERNEL_SERIAL,
+    CRC32C_KERNEL_3WAY,
+    CRC32C_KERNEL_PCLMUL,
+    CRC32C_KERNEL_VPCLMUL,
+    CRC32C_KERNEL_PMULL,
+    CRC32C_KERNEL_PMULL_EOR3,
+    CRC32C_KERNEL_COUNT,
+} Crc32cKernel;
+
+uint32_t CRC32C(unsigned char* data, size_t dataSize);
+
+// Incremental hashing for data that arrives in pieces. Init, Update any number of times, then Final gives the same
+// value CRC32C() would for the concatenated data. Uses whatever kernel CRC32C() is bound to.
+typedef struct Crc32cState {
+    uint32_t crc;
+    uint64_t length;
+} Crc32cState;
+
+void CRC32C_Init(Crc32cState* state);
+void CRC32C_Update(Crc32cState* state, const void* data, size_t dataSize);
+uint32_t CRC32C_Final(const Crc32cState* state);
+
+// Advances a raw CRC register past length zero bytes. O(log length).
+uint32_t CRC32C_Shift(uint32_t crc, uint64_t length);
+// CRC32C of A || B from CRC32C(A), CRC32C(B) and the length of B. O(log lengthB).
+uint32_t CRC32C_Combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB);
+
+// Feeds count copies of value into the hash in O(log count), without reading any memory.
+void CRC32C_UpdateRun(Crc32cState* state, unsigned char value, uint64_t count);
+// CRC32C of A followed by count copies of value, from CRC32C(A).
+uint32_t CRC32C_ExtendRun(uint32_t crc, unsigned char value, uint64_t count);
+// Length of the run of bytes equal to the last byte at the end of the buffer.
+size_t CRC32C_TrailingRunLength(const unsigned char* data, size_t dataSize);
+
+// Trailing runs shorter than this are hashed normally.
+#define CRC32C_MIN_PADDING (64 * 1024)
+
+// Same result as CRC32C_Parallel with all threads, but a constant fill at the end of the buffer (the padding of a 64MB
+// debug ROM) is accounted for with CRC32C_ExtendRun instead of being hashed.
+uint32_t CRC32C_SkipPadding(const unsigned char* data, size_t dataSize);
+
+// Splits the buffer into shards, hashes them on up to threadCount threads and combines the results. A threadCount of
+// 0 uses one thread per hardware thread. Small buffers are hashed on the calling thread.
+uint32_t CRC32C_Parallel(const unsigned char* data, size_t dataSize, unsigned threadCount);
+
+// Binds CRC32C() to a kernel. CRC32C_KERNEL_AUTO honors the environment override and otherwise picks the fastest
+// kernel the CPU supports. Returns 0 and leaves the current kernel alone if the kernel can't run here.
+int CRC32C_SetKernel(Crc32cKernel kernel);
+Crc32cKernel CRC32C_GetKernel(void);
+int CRC32C_KernelSupported(Crc32cKernel kernel);
+const char* CRC32C_KernelName(Crc32cKernel kernel);
+// Returns CRC32C_KERNEL_COUNT if the name is unknown.
+Crc32cKernel CRC32C_KernelFromName(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+#include "FastCrc32C.h"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Below this a shard costs more to hand to a thread than to hash.
+static constexpr size_t MIN_SHARD_SIZE = 4 * 1024 * 1024;
+
+extern "C" uint32_t CRC32C_Parallel(const unsigned char* data, size_t dataSize, unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const size_t shardCount = std::min<size_t>(threadCount, std::max<size_t>(1, dataSize / MIN_SHARD_SIZE));
+
+    if (shardCount == 1) {
+        return CRC32C((unsigned char*)data, dataSize);
+    }
+
+    // Keep shard boundaries 64 byte aligned so no kernel has to split a cache line with its neighbour.
+    const size_t shardSize = (dataSize / shardCount) & ~(size_t)63;
+    std::vector<uint32_t> crcs(shardCount);
+    std::vector<std::thread> threads;
+
+    threads.reserve(shardCount - 1);
+    for (size_t i = 1; i < shardCount; i++) {
+        const unsigned char* shard = data + i * shardSize;
+        const size_t size = i == shardCount - 1 ? dataSize - i * shardSize : shardSize;
+
+        try {
+            threads.emplace_back([&crcs, i, shard, size]() { crcs[i] = CRC32C((unsigned char*)shard, size); });
+        } catch (const std::system_error&) {
+            // Out of threads. Do this shard here instead.
+            crcs[i] = CRC32C((unsigned char*)shard, size);
+        }
+    }
+
+    crcs[0] = CRC32C((unsigned char*)data, shardSize);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    uint32_t crc = crcs[0];
+
+    for (size_t i = 1; i < shardCount; i++) {
+        const size_t size = i == shardCount - 1 ? dataSize - i * shardSize : shardSize;
+
+        crc = CRC32C_Combine(crc, crcs[i], size);
+    }
+    return crc;
+}
@@ -0,0 +1,60 @@
+#include "FastCrc32CTables.h"
+
+static constexpr uint32_t CRC32C_POLY = 0x82F63B78;
+
+static constexpr Crc32cSliceTables MakeSliceTables() {
+    Crc32cSliceTables tables = {};
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        tables.slice[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 16; k++) {
+            const uint32_t prev = tables.slice[k - 1][i];
+
+            tables.slice[k][i] = (prev >> 8) ^ tables.slice[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr uint32_t MultModP(uint32_t a, uint32_t b) {
+    uint32_t p = 0;
+
+    for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+        if (a & m) {
+            p ^= b;
+        }
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+static constexpr Crc32cX2nTable MakeX2nTable() {
+    Crc32cX2nTable table = {};
+    // x^1
+    uint32_t p = 1u << 30;
+
+    for (int n = 0; n < 31; n++) {
+        table.x2n[n] = p;
+        p = MultModP(p, p);
+    }
+    return table;
+}
+
+// Spot check against the well known values so a broken generator fails the build instead of every ROM.
+static_assert(MakeSliceTables().slice[0][1] == 0xF26B8303);
+static_assert(MakeSliceTables().slice[0][255] == 0xAD7D5351);
+// x^32 mod P is the polynomial itself, which is also the bytewise table entry for 0x80.
+static_assert(MakeX2nTable().x2n[5] == MakeSliceTables().slice[0][0x80]);
+// The table wraps: squaring the last entry gives x^1 back.
+static_assert(MultModP(MakeX2nTable().x2n[30], MakeX2nTable().x2n[30]) == MakeX2nTable().x2n[0]);
+
+extern "C" constexpr Crc32cSliceTables crc32cSliceTables = MakeSliceTables();
+extern "C" constexpr Crc32cX2nTable crc32cX2nTable = MakeX2nTable();
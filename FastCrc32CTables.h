@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lookup tables for the slicing-by-16 CRC32C kernel. slice[0] is the classic bytewise table, slice[k] advances a byte
+// through k more zero bytes. Generated at compile time in FastCrc32CTables.cpp.
+typedef struct Crc32cSliceTables {
+    uint32_t slice[16][256];
+} Crc32cSliceTables;
+
+extern const Crc32cSliceTables crc32cSliceTables;
+
+// x^(2^n) mod P for n = 0..30, reflected. x^(2^31) mod P is x again, so longer shifts walk the table modulo 31.
+typedef struct Crc32cX2nTable {
+    uint32_t x2n[31];
+} Crc32cX2nTable;
+
+extern const Crc32cX2nTable crc32cX2nTable;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,475 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "RomLoader.h"
+
+namespace {
+
+// Builds the result once a file's bytes are all in buffer. buffer is ours, so a full read is swapped in place.
+void RomBatchFinish(const RomBuffer& buffer, size_t length, uint64_t fileSize, RomBatchMode mode,
+                    RomHeaderFixup fixHeader, RomBatchResult* result) {
+    memset(result, 0, sizeof(*result));
+    if (length < ROM_HEADER_SIZE) {
+        return;
+    }
+    result->size = fileSize;
+    result->byteOrder = buffer.data[0];
+    result->backing = buffer.backing;
+    if (mode == ROM_BATCH_FULL) {
+        result->crc = RomToBigEndianCrc32C(buffer.data, length, fixHeader);
+        memcpy(result->header, buffer.data, ROM_HEADER_SIZE);
+    } else {
+        RomCopyToBigEndian(result->header, buffer.data, ROM_HEADER_SIZE);
+        if (fixHeader != nullptr) {
+            fixHeader(result->header, ROM_HEADER_SIZE);
+        }
+    }
+    result->ok = 1;
+}
+
+// Reads one file with blocking I/O. The fallback's unit of work.
+void RomBatchReadBlocking(const char* path, RomBatchMode mode, RomHeaderFixup fixHeader, RomBatchResult* result) {
+    FILE* file = fopen(path, "rb");
+    RomBuffer buffer;
+    long fileSize;
+    size_t length;
+
+    memset(result, 0, sizeof(*result));
+    if (file == nullptr) {
+        return;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (fileSize = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return;
+    }
+    length = mode == ROM_BATCH_FULL ? (size_t)fileSize : std::min((size_t)fileSize, (size_t)ROM_BATCH_PROBE_SIZE);
+    buffer = RomBuffer_Acquire(length);
+    setvbuf(file, nullptr, _IONBF, 0);
+    if (buffer.data != nullptr && fread(buffer.data, 1, length, file) == length) {
+        RomBatchFinish(buffer, length, (uint64_t)fileSize, mode, fixHeader, result);
+    }
+    RomBuffer_Release(buffer);
+    fclose(file);
+}
+
+// Workers pull the next path off a shared counter. Returns 0 if no worker could be started, in which case the calling
+// thread does the whole batch itself.
+int RomBatchRunPool(const char* const* paths, size_t count, RomBatchMode mode, RomHeaderFixup fixHeader,
+                    RomBatchCallback callback, void* user) {
+    const size_t threadCount =
+        std::min(count, (size_t)(mode == ROM_BATCH_FULL ? ROM_BATCH_READ_THREADS : ROM_BATCH_PROBE_THREADS));
+    std::atomic<size_t> next(0);
+    std::mutex callbackLock;
+    std::vector<std::thread> threads;
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            RomBatchResult result;
+
+            RomBatchReadBlocking(paths[i], mode, fixHeader, &result);
+            std::lock_guard<std::mutex> lock(callbackLock);
+            callback(user, i, &result);
+        }
+    };
+
+    for (size_t i = 0; i < threadCount; i++) {
+        try {
+            threads.emplace_back(worker);
+        } catch (const std::system_error&) {
+            break;
+        }
+    }
+    // With at least one worker running every path gets done. With none, fall through to the caller.
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return !threads.empty() || count == 0;
+}
+
+#ifdef __linux__
+
+// Just enough of io_uring to queue reads and reap completions, without depending on liburing.
+struct RomUring {
+    int fd = -1;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned sqEntries;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+    void* sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void* cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    // SQEs filled in but not yet handed to the kernel.
+    unsigned pending = 0;
+
+    ~RomUring() {
+        if (sqes != nullptr && sqesSize != 0) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool Init(unsigned entries) {
+        io_uring_params params;
+
+        memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) {
+            return false;
+        }
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing = sqRing;
+        } else {
+            cqRing =
+                mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                return false;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                   IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            sqes = nullptr;
+            return false;
+        }
+
+        unsigned char* sq = (unsigned char*)sqRing;
+        unsigned char* cq = (unsigned char*)cqRing;
+        sqHead = (unsigned*)(sq + params.sq_off.head);
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Returns nullptr if the submission queue is full.
+    io_uring_sqe* GetSqe() {
+        const unsigned tail = *sqTail + pending;
+
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+            return nullptr;
+        }
+        sqArray[tail & *sqMask] = tail & *sqMask;
+        pending++;
+        return &sqes[tail & *sqMask];
+    }
+
+    // Hands the queued SQEs to the kernel and, if wait is set, blocks until at least one completion is ready.
+    bool Submit(bool wait) {
+        const unsigned toSubmit = pending;
+
+        __atomic_store_n(sqTail, *sqTail + pending, __ATOMIC_RELEASE);
+        pending = 0;
+        for (;;) {
+            if (syscall(__NR_io_uring_enter, fd, toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, nullptr,
+                        0) >= 0) {
+                return true;
+            }
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    io_uring_cqe* PeekCqe() {
+        const unsigned head = *cqHead;
+
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return nullptr;
+        }
+        return &cqes[head & *cqMask];
+    }
+
+    void SeenCqe() {
+        __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+    }
+
+    // SQEs handed over that the kernel hasn't picked up. Without SQPOLL it only picks them up in a submitting enter.
+    unsigned Unconsumed() const {
+        return *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    // Waits for count more completions and throws them away. For tearing down after a failed Submit, so no read can
+    // still land in a buffer once it's released.
+    bool Drain(unsigned count) {
+        while (count > 0) {
+            if (PeekCqe() != nullptr) {
+                SeenCqe();
+                count--;
+                continue;
+            }
+            if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct RomUringFile;
+
+// One outstanding read. A file is read as several pieces so a big file doesn't hog a single queue slot.
+struct RomUringPiece {
+    RomUringFile* file;
+    iovec iov;
+    uint64_t offset;
+};
+
+struct RomUringFile {
+    size_t index;
+    int fd;
+    uint64_t fileSize;
+    size_t length;
+    RomBuffer buffer = { nullptr, 0, ROM_BUFFER_HEAP };
+    std::vector<RomUringPiece> pieces;
+    size_t nextPiece = 0;
+    size_t piecesLeft;
+    bool failed = false;
+
+    ~RomUringFile() {
+        RomBuffer_Release(buffer);
+    }
+};
+
+// Returns 0 without reporting anything if io_uring isn't available. Once it has started, every path is reported.
+int RomBatchRunUring(const char* const* paths, size_t count, RomBatchMode mode, RomHeaderFixup fixHeader,
+                     RomBatchCallback callback, void* user) {
+    RomUring ring;
+    std::vector<std::unique_ptr<RomUringFile>> files;
+    size_t nextPath = 0;
+    size_t memoryInFlight = 0;
+    size_t readsInFlight = 0;
+
+    if (!ring.Init(ROM_BATCH_QUEUE_DEPTH)) {
+        return 0;
+    }
+
+    auto finish = [&](RomUringFile* file) {
+        RomBatchResult result;
+
+        if (file->failed) {
+            memset(&result, 0, sizeof(result));
+        } else {
+            RomBatchFinish(file->buffer, file->length, file->fileSize, mode, fixHeader, &result);
+        }
+        callback(user, file->index, &result);
+        memoryInFlight -= file->length;
+        close(file->fd);
+        files.erase(std::find_if(files.begin(), files.end(), [&](const auto& f) { return f.get() == file; }));
+    };
+
+    // Opens the next path and splits it into pieces, unless the memory budget is spent. Files that can't be opened
+    // are reported straight away.
+    auto admit = [&]() -> bool {
+        while (nextPath < count) {
+            const size_t index = nextPath;
+            struct stat st;
+            int fd;
+
+            if (!files.empty() && mode == ROM_BATCH_FULL && memoryInFlight >= ROM_BATCH_MEMORY) {
+                return false;
+            }
+            nextPath++;
+            fd = ::open(paths[index], O_RDONLY | O_CLOEXEC);
+            if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                RomBatchResult result;
+
+                if (fd >= 0) {
+                    close(fd);
+                }
+                memset(&result, 0, sizeof(result));
+                callback(user, index, &result);
+                continue;
+            }
+
+            auto file = std::make_unique<RomUringFile>();
+            file->index = index;
+            file->fd = fd;
+            file->fileSize = (uint64_t)st.st_size;
+            file->length = mode == ROM_BATCH_FULL ? (size_t)st.st_size
+                                                  : std::min((size_t)st.st_size, (size_t)ROM_BATCH_PROBE_SIZE);
+            file->buffer = RomBuffer_Acquire(file->length);
+            if (file->buffer.data == nullptr) {
+                file->failed = true;
+                file->length = 0;
+            }
+            for (size_t pos = 0; pos < file->length; pos += ROM_BATCH_READ_SIZE) {
+                const size_t size = std::min(file->length - pos, (size_t)ROM_BATCH_READ_SIZE);
+                file->pieces.push_back({ file.get(), { file->buffer.data + pos, size }, pos });
+            }
+            file->piecesLeft = file->pieces.size();
+            memoryInFlight += file->length;
+            if (file->piecesLeft == 0) {
+                RomUringFile* empty = file.get();
+                files.push_back(std::move(file));
+                finish(empty);
+                continue;
+            }
+            files.push_back(std::move(file));
+            return true;
+        }
+        return false;
+    };
+
+    auto queue = [&](RomUringPiece* piece) -> bool {
+        io_uring_sqe* sqe = ring.GetSqe();
+
+        if (sqe == nullptr) {
+            return false;
+        }
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = piece->file->fd;
+        sqe->addr = (uint64_t)(uintptr_t)&piece->iov;
+        sqe->len = 1;
+        sqe->off = piece->offset;
+        sqe->user_data = (uint64_t)(uintptr_t)piece;
+        readsInFlight++;
+        return true;
+    };
+
+    for (;;) {
+        // Fill the queue, oldest files first so their pieces finish together.
+        bool full = false;
+        for (size_t i = 0; !full; i++) {
+            if (i == files.size() && !admit()) {
+                break;
+            }
+            RomUringFile* file = files[i].get();
+            while (file->nextPiece < file->pieces.size()) {
+                if (readsInFlight >= ROM_BATCH_QUEUE_DEPTH || !queue(&file->pieces[file->nextPiece])) {
+                    full = true;
+                    break;
+                }
+                file->nextPiece++;
+            }
+        }
+        if (readsInFlight == 0) {
+            break;
+        }
+        if (!ring.Submit(true)) {
+            // The ring is unusable. Wait out the reads the kernel already took, then finish every unreported file
+            // with blocking reads. Only if even that wait fails are the buffers leaked, since a read could still land
+            // in them.
+            const bool drained = ring.Drain((unsigned)readsInFlight - ring.Unconsumed());
+
+            for (auto& file : files) {
+                RomBatchResult result;
+
+                close(file->fd);
+                RomBatchReadBlocking(paths[file->index], mode, fixHeader, &result);
+                callback(user, file->index, &result);
+                if (!drained) {
+                    file.release();
+                }
+            }
+            files.clear();
+            for (; nextPath < count; nextPath++) {
+                RomBatchResult result;
+
+                RomBatchReadBlocking(paths[nextPath], mode, fixHeader, &result);
+                callback(user, nextPath, &result);
+            }
+            return 1;
+        }
+
+        for (io_uring_cqe* cqe = ring.PeekCqe(); cqe != nullptr; cqe = ring.PeekCqe()) {
+            RomUringPiece* piece = (RomUringPiece*)(uintptr_t)cqe->user_data;
+            RomUringFile* file = piece->file;
+            const int res = cqe->res;
+
+            ring.SeenCqe();
+            readsInFlight--;
+            if (res > 0 && (size_t)res < piece->iov.iov_len) {
+                // Short read. Ask for the rest.
+                piece->iov.iov_base = (unsigned char*)piece->iov.iov_base + res;
+                piece->iov.iov_len -= res;
+                piece->offset += res;
+                if (queue(piece)) {
+                    continue;
+                }
+                file->failed = true;
+            } else if (res <= 0) {
+                // An error, or the file shrank under us.
+                file->failed = true;
+            }
+            if (--file->piecesLeft == 0) {
+                finish(file);
+            }
+        }
+    }
+    return 1;
+}
+
+#endif
+
+} // namespace
+
+extern "C" void RomBatch_Run(const char* const* paths, size_t count, RomBatchMode mode, RomHeaderFixup fixHeader,
+                             RomBatchCallback callback, void* user) {
+#ifdef __linux__
+    if (RomBatchRunUring(paths, count, mode, fixHeader, callback, user)) {
+        return;
+    }
+#endif
+    if (RomBatchRunPool(paths, count, mode, fixHeader, callback, user)) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        RomBatchResult result;
+
+        RomBatchReadBlocking(paths[i], mode, fixHeader, &result);
+        callback(user, i, &result);
+    }
+}
@@ -0,0 +1,181 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <mutex>
+
+#include "RomLoader.h"
+
+namespace {
+
+std::mutex sPoolLock;
+RomBuffer sPool[ROM_BUFFER_POOL_SLOTS];
+
+size_t RomBufferRound(size_t size, size_t granule) {
+    return (size + granule - 1) & ~(granule - 1);
+}
+
+#ifdef __linux__
+// madvise(MADV_HUGEPAGE) succeeds even when THP is switched off, so ask sysfs whether the advice will be taken. The
+// active mode is the bracketed one, e.g. "always [madvise] never".
+bool RomBufferThpEnabled() {
+    static const bool enabled = []() {
+        FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        char modes[128] = {};
+
+        if (file == nullptr) {
+            return false;
+        }
+        const bool read = fgets(modes, sizeof(modes), file) != nullptr;
+        fclose(file);
+        return read && (strstr(modes, "[always]") != nullptr || strstr(modes, "[madvise]") != nullptr);
+    }();
+
+    return enabled;
+}
+
+// Tries for huge page backing, best first. capacity is a multiple of ROM_BUFFER_HUGE_PAGE.
+bool RomBufferMapHuge(RomBuffer* buffer, size_t capacity) {
+    void* data;
+
+#ifdef MAP_HUGETLB
+    // Only succeeds if the admin reserved huge pages (vm.nr_hugepages), but then the pages are guaranteed.
+    data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+        *buffer = { (unsigned char*)data, capacity, ROM_BUFFER_HUGETLB };
+        return true;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (!RomBufferThpEnabled()) {
+        return false;
+    }
+    // Transparent huge pages need a 2MB aligned range, which mmap doesn't promise. Over-allocate and trim the ends.
+    unsigned char* raw = (unsigned char*)mmap(nullptr, capacity + ROM_BUFFER_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return false;
+    }
+    unsigned char* aligned = (unsigned char*)RomBufferRound((uintptr_t)raw, ROM_BUFFER_HUGE_PAGE);
+    if (aligned != raw) {
+        munmap(raw, aligned - raw);
+    }
+    munmap(aligned + capacity, raw + ROM_BUFFER_HUGE_PAGE - aligned);
+    if (madvise(aligned, capacity, MADV_HUGEPAGE) != 0) {
+        // THP is compiled out. The mapping is still fine, just with small pages.
+        munmap(aligned, capacity);
+        return false;
+    }
+    *buffer = { aligned, capacity, ROM_BUFFER_THP };
+    return true;
+#else
+    return false;
+#endif
+}
+#endif
+
+void RomBufferFree(RomBuffer buffer) {
+    if (buffer.backing == ROM_BUFFER_HEAP) {
+        free(buffer.data);
+        return;
+    }
+#ifdef __linux__
+    munmap(buffer.data, buffer.capacity);
+#endif
+}
+
+} // namespace
+
+extern "C" RomBuffer RomBuffer_Acquire(size_t size) {
+    RomBuffer buffer = { nullptr, 0, ROM_BUFFER_HEAP };
+
+    {
+        std::lock_guard<std::mutex> lock(sPoolLock);
+        // No more than twice what's needed, so a probe doesn't walk off with a ring or ROM buffer that the next big
+        // read will have to allocate and fault in again.
+        const size_t limit = 2 * RomBufferRound(size == 0 ? 1 : size, ROM_BUFFER_GRANULE);
+        RomBuffer* best = nullptr;
+
+        // The smallest pooled buffer that fits, so a 32MB ROM doesn't take the buffer a 64MB one could have used.
+        for (RomBuffer& slot : sPool) {
+            if (slot.data != nullptr && slot.capacity >= size && slot.capacity <= limit &&
+                (best == nullptr || slot.capacity < best->capacity)) {
+                best = &slot;
+            }
+        }
+        if (best != nullptr) {
+            buffer = *best;
+            *best = { nullptr, 0, ROM_BUFFER_HEAP };
+            return buffer;
+        }
+    }
+    // Deliberately not zeroed. Every byte is about to be overwritten by a read, and touching the pages now would only
+    // fault them in early.
+#ifdef __linux__
+    if (size >= ROM_BUFFER_HUGE_PAGE && RomBufferMapHuge(&buffer, RomBufferRound(size, ROM_BUFFER_HUGE_PAGE))) {
+        return buffer;
+    }
+#endif
+    buffer.capacity = RomBufferRound(size == 0 ? 1 : size, ROM_BUFFER_GRANULE);
+    buffer.data = (unsigned char*)malloc(buffer.capacity);
+    if (buffer.data == nullptr) {
+        buffer.capacity = 0;
+    }
+    return buffer;
+}
+
+extern "C" void RomBuffer_Release(RomBuffer buffer) {
+    if (buffer.data == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sPoolLock);
+        RomBuffer* smallest = nullptr;
+
+        for (RomBuffer& slot : sPool) {
+            if (slot.data == nullptr) {
+                slot = buffer;
+                return;
+            }
+            if (smallest == nullptr || slot.capacity < smallest->capacity) {
+                smallest = &slot;
+            }
+        }
+        // Pool is full. Keep the bigger of the two, since it can serve any request the smaller one could.
+        if (smallest->capacity < buffer.capacity) {
+            const RomBuffer evicted = *smallest;
+
+            *smallest = buffer;
+            buffer = evicted;
+        }
+    }
+    RomBufferFree(buffer);
+}
+
+extern "C" void RomBuffer_Trim(void) {
+    std::lock_guard<std::mutex> lock(sPoolLock);
+
+    for (RomBuffer& slot : sPool) {
+        if (slot.data != nullptr) {
+            RomBufferFree(slot);
+        }
+        slot = { nullptr, 0, ROM_BUFFER_HEAP };
+    }
+}
+
+extern "C" const char* RomBuffer_BackingName(RomBufferBacking backing) {
+    switch (backing) {
+        case ROM_BUFFER_THP:
+            return "thp";
+        case ROM_BUFFER_HUGETLB:
+            return "hugetlb";
+        case ROM_BUFFER_HEAP:
+        default:
+            return "heap";
+    }
+}
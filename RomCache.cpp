@@ -0,0 +1,272 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "RomCache.h"
+
+static_assert(sizeof(RomCacheEntry) == 48 + ROM_HEADER_SIZE, "RomCacheEntry is written to disk as is");
+
+namespace {
+
+struct RomCacheFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t count;
+};
+
+constexpr char ROM_CACHE_MAGIC[4] = { 'O', 'R', 'S', 'C' };
+
+std::filesystem::path RomCacheDefaultPath() {
+    const char* base;
+
+#if defined(_WIN32)
+    if ((base = getenv("LOCALAPPDATA")) != nullptr) {
+        return std::filesystem::path(base) / "OTRExporter" / "romscan.bin";
+    }
+#elif defined(__APPLE__)
+    if ((base = getenv("HOME")) != nullptr) {
+        return std::filesystem::path(base) / "Library" / "Caches" / "OTRExporter" / "romscan.bin";
+    }
+#else
+    if ((base = getenv("XDG_CACHE_HOME")) != nullptr && base[0] != '\0') {
+        return std::filesystem::path(base) / "otr-exporter" / "romscan.bin";
+    }
+    if ((base = getenv("HOME")) != nullptr) {
+        return std::filesystem::path(base) / ".cache" / "otr-exporter" / "romscan.bin";
+    }
+#endif
+    // Nowhere to keep it. The working directory is likely the very directory being scanned, so don't write there.
+    return {};
+}
+
+uint32_t RomCacheToday() {
+    return (uint32_t)(time(nullptr) / (24 * 60 * 60));
+}
+
+using RomCacheKey = std::pair<uint64_t, uint64_t>;
+using RomCacheMap = std::map<RomCacheKey, RomCacheEntry>;
+
+// Reads every entry of a cache file into entries. A missing, foreign or outdated file adds nothing.
+void RomCacheRead(const std::filesystem::path& path, RomCacheMap* entries) {
+    FILE* file = fopen(path.string().c_str(), "rb");
+    RomCacheFileHeader header;
+
+    if (file == nullptr) {
+        return;
+    }
+    if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, ROM_CACHE_MAGIC, 4) == 0 &&
+        header.version == ROM_CACHE_VERSION && header.entrySize == sizeof(RomCacheEntry)) {
+        RomCacheEntry entry;
+
+        for (uint32_t i = 0; i < header.count && fread(&entry, sizeof(entry), 1, file) == 1; i++) {
+            (*entries)[{ entry.device, entry.inode }] = entry;
+        }
+    }
+    fclose(file);
+}
+
+// Advisory lock on a file next to the cache, held from re-reading the cache to renaming the new one into place. Other
+// processes (a watcher and the picker, say) then merge with each other's saves instead of overwriting them.
+class RomCacheLock {
+  public:
+    explicit RomCacheLock(const std::filesystem::path& cachePath) {
+        const std::string path = cachePath.string() + ".lock";
+
+#ifdef _WIN32
+        mFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mFile != INVALID_HANDLE_VALUE) {
+            OVERLAPPED overlapped = {};
+
+            mLocked = LockFileEx(mFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0;
+        }
+#else
+        mFd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (mFd >= 0) {
+            int result;
+
+            while ((result = flock(mFd, LOCK_EX)) != 0 && errno == EINTR) {
+            }
+            mLocked = result == 0;
+        }
+#endif
+    }
+
+    ~RomCacheLock() {
+#ifdef _WIN32
+        if (mFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(mFile);
+        }
+#else
+        if (mFd >= 0) {
+            close(mFd);
+        }
+#endif
+    }
+
+    bool Locked() const {
+        return mLocked;
+    }
+
+  private:
+#ifdef _WIN32
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+#else
+    int mFd = -1;
+#endif
+    bool mLocked = false;
+};
+
+} // namespace
+
+struct RomCache {
+    std::filesystem::path path;
+    RomCacheMap entries;
+    // Entries this process stored since the last save. They win over whatever another process saved for the same file.
+    std::set<RomCacheKey> put;
+    uint32_t today = RomCacheToday();
+    bool dirty = false;
+};
+
+extern "C" RomCache* RomCache_Open(const char* path) {
+    RomCache* cache = new RomCache;
+    const char* env = getenv(ROM_CACHE_ENV);
+
+    cache->path = path != nullptr ? std::filesystem::path(path)
+                  : env != nullptr ? std::filesystem::path(env)
+                                   : RomCacheDefaultPath();
+    if (!cache->path.empty()) {
+        RomCacheRead(cache->path, &cache->entries);
+    }
+    return cache;
+}
+
+extern "C" const RomCacheEntry* RomCache_Find(RomCache* cache, const RomCandidate* file) {
+    const auto it = cache->entries.find({ file->device, file->inode });
+
+    if (it == cache->entries.end() || it->second.size != file->size || it->second.mtime != file->mtime) {
+        return nullptr;
+    }
+    // At most one rewrite a day for a file that's only ever hit.
+    if (it->second.lastSeen != cache->today) {
+        it->second.lastSeen = cache->today;
+        cache->dirty = true;
+    }
+    return &it->second;
+}
+
+extern "C" void RomCache_Put(RomCache* cache, const RomCacheEntry* entry) {
+    RomCacheEntry& slot = cache->entries[{ entry->device, entry->inode }];
+    RomCacheEntry stamped = *entry;
+
+    stamped.lastSeen = cache->today;
+    if (memcmp(&slot, &stamped, sizeof(stamped)) != 0) {
+        slot = stamped;
+        cache->put.insert({ entry->device, entry->inode });
+        cache->dirty = true;
+    }
+}
+
+extern "C" int RomCache_Save(RomCache* cache) {
+#ifdef _WIN32
+    const int pid = _getpid();
+#else
+    const int pid = (int)getpid();
+#endif
+    // Unique per process, so two savers never write into the same temp file.
+    const std::filesystem::path temp = cache->path.string() + "." + std::to_string(pid) + ".tmp";
+    RomCacheFileHeader header;
+    RomCacheMap saved;
+    std::error_code error;
+    FILE* file;
+    bool ok;
+
+    for (const auto& [key, entry] : cache->entries) {
+        if (entry.lastSeen + ROM_CACHE_MAX_AGE_DAYS < cache->today) {
+            cache->dirty = true;
+            break;
+        }
+    }
+    if (!cache->dirty || cache->path.empty()) {
+        return cache->dirty ? 0 : 1;
+    }
+    if (cache->path.has_parent_path()) {
+        std::filesystem::create_directories(cache->path.parent_path(), error);
+    }
+    RomCacheLock lock(cache->path);
+    if (!lock.Locked()) {
+        return 0;
+    }
+    // Fold in what other processes saved since this one loaded the file. Their entries are kept unless this process
+    // stored something newer for the same file.
+    RomCacheRead(cache->path, &saved);
+    for (const auto& [key, entry] : saved) {
+        const auto it = cache->entries.find(key);
+
+        if (it == cache->entries.end()) {
+            cache->entries[key] = entry;
+        } else if (cache->put.count(key) == 0) {
+            const uint32_t lastSeen = it->second.lastSeen > entry.lastSeen ? it->second.lastSeen : entry.lastSeen;
+
+            it->second = entry;
+            it->second.lastSeen = lastSeen;
+        }
+    }
+
+    for (auto it = cache->entries.begin(); it != cache->entries.end();) {
+        if (it->second.lastSeen + ROM_CACHE_MAX_AGE_DAYS < cache->today) {
+            it = cache->entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    file = fopen(temp.string().c_str(), "wb");
+    if (file == nullptr) {
+        return 0;
+    }
+    memcpy(header.magic, ROM_CACHE_MAGIC, 4);
+    header.version = ROM_CACHE_VERSION;
+    header.entrySize = sizeof(RomCacheEntry);
+    header.count = (uint32_t)cache->entries.size();
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (const auto& [key, entry] : cache->entries) {
+        ok = ok && fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+    ok = fclose(file) == 0 && ok;
+    if (ok) {
+        std::filesystem::rename(temp, cache->path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(temp, error);
+        return 0;
+    }
+    cache->put.clear();
+    cache->dirty = false;
+    return 1;
+}
+
+extern "C" void RomCache_Close(RomCache* cache) {
+    delete cache;
+}
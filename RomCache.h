@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "RomDiscovery.h"
+#include "RomLoader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Environment variable that overrides where the scan cache is kept, e.g. OTR_ROM_CACHE=/tmp/romscan.bin.
+#define ROM_CACHE_ENV "OTR_ROM_CACHE"
+// Bumped whenever RomCacheEntry changes. A cache file with another version is ignored and rewritten.
+#define ROM_CACHE_VERSION 2
+// Entries for files that haven't been looked up or stored in this many days are dropped when the cache is saved. Files
+// that were deleted or moved leave nothing behind for longer than that.
+#define ROM_CACHE_MAX_AGE_DAYS 30
+
+typedef enum RomCacheVerdict {
+    // Only the header has been read. romCrc isn't valid.
+    ROM_CACHE_UNKNOWN,
+    ROM_CACHE_GOOD,
+    ROM_CACHE_BAD,
+} RomCacheVerdict;
+
+// What's known about one file. Stored as is in the cache file, so the layout is fixed: no padding, and only
+// fixed-width fields.
+typedef struct RomCacheEntry {
+    // The key. A file whose size or mtime changed is a miss.
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t romCrc;
+    // Day (since the epoch) the file was last looked up or stored. Maintained by the cache.
+    uint32_t lastSeen;
+    uint8_t byteOrder;
+    uint8_t verdict;
+    uint8_t reserved[6];
+    // Big endian and fixed up, same as RomFileHash.
+    unsigned char header[ROM_HEADER_SIZE];
+} RomCacheEntry;
+
+typedef struct RomCache RomCache;
+
+// Loads the cache from path, or from the default location in the user's cache directory if path is NULL. A missing
+// or unreadable file gives an empty cache. If there's no user cache directory to default to, the cache lives in memory
+// only and is never saved.
+RomCache* RomCache_Open(const char* path);
+// Returns the entry for file if its identity, size and mtime all match, otherwise NULL. Valid until the next Put.
+const RomCacheEntry* RomCache_Find(RomCache* cache, const RomCandidate* file);
+// Adds the entry, replacing any older entry for the same file.
+void RomCache_Put(RomCache* cache, const RomCacheEntry* entry);
+// Drops stale entries and writes the cache back if anything changed. The file is replaced atomically, so a crash can't
+// leave half a cache. Under an advisory lock on a .lock file next to it, entries other processes saved in the meantime
+// are merged in first, so concurrent savers don't lose each other's work. Returns 0 if it couldn't be written.
+int RomCache_Save(RomCache* cache);
+void RomCache_Close(RomCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,481 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+// Keeps Windows.h from defining min and max, which break std::max.
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "RomDiscovery.h"
+#include "RomLoader.h"
+
+namespace {
+
+std::string RomDiscoveryJoin(const std::string& dir, const char* name) {
+    if (dir == ".") {
+        return name;
+    }
+    std::string path = dir;
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+        path += '/';
+    }
+    return path + name;
+}
+
+// '*' matches any run of characters and '?' any one character. Enough for excludes like ".git" or "*.bak".
+bool RomDiscoveryGlob(const char* pattern, const char* text) {
+    const char* star = nullptr;
+    const char* resume = nullptr;
+
+    while (*text != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        } else if (star != nullptr) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+#ifdef _WIN32
+// FNV-1a. Stands in for an inode number.
+uint64_t RomDiscoveryHashPath(const char* path) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (; *path != '\0'; path++) {
+        hash = (hash ^ (unsigned char)*path) * 0x100000001B3ull;
+    }
+    return hash;
+}
+#else
+// Fills in size, mtime and identity. Fails for anything that isn't a regular file once symlinks are followed.
+bool RomDiscoveryStatAt(int dirFd, const char* name, RomCandidate* candidate) {
+#if defined(__linux__) && defined(STATX_SIZE)
+    struct statx stx;
+
+    // Ask for just what the filter and the scan cache need. On network filesystems the rest can cost a round trip.
+    if (statx(dirFd, name, 0, STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) != 0 ||
+        !S_ISREG(stx.stx_mode)) {
+        return false;
+    }
+    candidate->size = stx.stx_size;
+    candidate->mtime = (int64_t)stx.stx_mtime.tv_sec * 1000000000 + stx.stx_mtime.tv_nsec;
+    candidate->device = ((uint64_t)stx.stx_dev_major << 32) | stx.stx_dev_minor;
+    candidate->inode = stx.stx_ino;
+#else
+    struct stat st;
+
+    if (fstatat(dirFd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    candidate->size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+    candidate->mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    candidate->mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    candidate->device = (uint64_t)st.st_dev;
+    candidate->inode = (uint64_t)st.st_ino;
+#endif
+    return true;
+}
+#endif
+
+struct RomCrawlDir {
+    std::string path;
+    int depth;
+};
+
+// A directory queue per worker. Workers take their newest directory (depth first, so a worker stays in one part of
+// the tree) and steal the oldest from others, which tends to be near a root and so is a big piece of work.
+struct RomCrawlQueue {
+    std::mutex lock;
+    std::deque<RomCrawlDir> dirs;
+};
+
+class RomCrawler {
+  public:
+    RomCrawler(const RomCrawlOptions* options, RomCandidateCallback callback, void* user)
+        : mOptions(options), mCallback(callback), mUser(user) {
+    }
+
+    int Run() {
+        const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        unsigned threadCount = mOptions->threadCount != 0 ? mOptions->threadCount : hardwareThreads;
+        std::vector<std::thread> threads;
+
+        // One directory that isn't descended into is one worker's job. Others would only start up and leave.
+        if (mOptions->rootCount <= 1 && mOptions->maxDepth == 0) {
+            threadCount = 1;
+        }
+        mQueues = std::vector<RomCrawlQueue>(threadCount);
+        for (size_t i = 0; i < mOptions->rootCount; i++) {
+            Push(i % threadCount, { mOptions->roots[i], 0 });
+        }
+        for (unsigned i = 1; i < threadCount; i++) {
+            try {
+                threads.emplace_back(&RomCrawler::Work, this, i);
+            } catch (const std::system_error&) {
+                break;
+            }
+        }
+        // The calling thread is a worker too, so the crawl finishes even if no thread could be started. Queues of
+        // workers that never started get stolen from.
+        Work(0);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        SniffQueued(std::move(mSniffs));
+        return mRootsRead.load() != 0;
+    }
+
+  private:
+    void Push(size_t queue, RomCrawlDir dir) {
+        mPending++;
+        {
+            std::lock_guard<std::mutex> lock(mQueues[queue].lock);
+            mQueues[queue].dirs.push_back(std::move(dir));
+        }
+        mQueued++;
+        // Taking the lock orders this with a worker that just checked mQueued and is about to wait.
+        {
+            std::lock_guard<std::mutex> lock(mIdleLock);
+        }
+        mIdle.notify_one();
+    }
+
+    bool Pop(size_t self, RomCrawlDir* dir) {
+        {
+            std::lock_guard<std::mutex> lock(mQueues[self].lock);
+            if (!mQueues[self].dirs.empty()) {
+                *dir = std::move(mQueues[self].dirs.back());
+                mQueues[self].dirs.pop_back();
+                mQueued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < mQueues.size(); i++) {
+            RomCrawlQueue& victim = mQueues[(self + i) % mQueues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+
+            if (!victim.dirs.empty()) {
+                *dir = std::move(victim.dirs.front());
+                victim.dirs.pop_front();
+                mQueued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Work(size_t self) {
+        RomCrawlDir dir;
+
+        // mPending counts directories queued or being read, so it only reaches 0 once nothing can queue more. Until
+        // then a worker with nothing to steal sleeps until a directory is queued.
+        for (;;) {
+            if (Pop(self, &dir)) {
+                ReadDir(self, dir);
+                if (--mPending == 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(mIdleLock);
+                    }
+                    mIdle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mIdleLock);
+            mIdle.wait(lock, [this]() { return mPending.load() == 0 || mQueued.load() != 0; });
+            if (mPending.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    bool Excluded(const std::string& path, const char* name) const {
+        return RomDiscovery_Excluded(mOptions, path.c_str(), name);
+    }
+
+    bool CanDescend(int depth) const {
+        return mOptions->maxDepth < 0 || depth < mOptions->maxDepth;
+    }
+
+    void Found(RomCandidate* candidate, const std::string& path) {
+        std::lock_guard<std::mutex> lock(mCallbackLock);
+
+        candidate->path = path.c_str();
+        mCallback(mUser, candidate);
+    }
+
+    // Files without a ROM extension are only read once enough have been found to fill a batch, from whichever
+    // directories they came, so a mixed tree costs a few deep batches of reads instead of one read per file.
+    void Sniff(const RomCandidate& candidate, const std::string& path) {
+        std::vector<std::pair<std::string, RomCandidate>> batch;
+        {
+            std::lock_guard<std::mutex> lock(mSniffLock);
+
+            mSniffs.emplace_back(path, candidate);
+            if (mSniffs.size() < ROM_BATCH_QUEUE_DEPTH) {
+                return;
+            }
+            batch.swap(mSniffs);
+        }
+        SniffQueued(std::move(batch));
+    }
+
+    void SniffQueued(std::vector<std::pair<std::string, RomCandidate>> batch) {
+        std::vector<const char*> paths;
+        std::vector<int> isRom(batch.size());
+
+        if (batch.empty()) {
+            return;
+        }
+        for (const auto& [path, candidate] : batch) {
+            paths.push_back(path.c_str());
+        }
+        RomDiscovery_Sniff(paths.data(), paths.size(), isRom.data());
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (isRom[i]) {
+                Found(&batch[i].second, batch[i].first);
+            }
+        }
+    }
+
+#ifdef _WIN32
+    void ReadDir(size_t self, const RomCrawlDir& dir) {
+        WIN32_FIND_DATAA ffd;
+        HANDLE h = FindFirstFileA(RomDiscoveryJoin(dir.path, "*").c_str(), &ffd);
+
+        if (h == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        if (dir.depth == 0) {
+            mRootsRead++;
+        }
+        do {
+            const std::string path = RomDiscoveryJoin(dir.path, ffd.cFileName);
+            RomCandidate candidate;
+
+            if (strcmp(ffd.cFileName, ".") == 0 || strcmp(ffd.cFileName, "..") == 0 || Excluded(path, ffd.cFileName)) {
+                continue;
+            }
+            if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                // Without inode numbers there's no cheap loop check, so junctions and directory links aren't entered.
+                if (CanDescend(dir.depth) && !(ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    Push(self, { path, dir.depth + 1 });
+                }
+                continue;
+            }
+            // The listing already carries the size and times, so nothing needs to be stat'ed at all.
+            const bool named = RomDiscovery_HasRomExtension(ffd.cFileName);
+            if (!named && !mOptions->sniff) {
+                continue;
+            }
+            candidate.size = ((uint64_t)ffd.nFileSizeHigh << 32) | ffd.nFileSizeLow;
+            candidate.mtime =
+                (int64_t)(((uint64_t)ffd.ftLastWriteTime.dwHighDateTime << 32) | ffd.ftLastWriteTime.dwLowDateTime);
+            candidate.device = 0;
+            candidate.inode = RomDiscoveryHashPath(path.c_str());
+            if (!RomDiscovery_IsRomSize(candidate.size)) {
+                continue;
+            }
+            if (named) {
+                Found(&candidate, path);
+            } else {
+                Sniff(candidate, path);
+            }
+        } while (FindNextFileA(h, &ffd) != 0);
+        FindClose(h);
+    }
+#else
+    // Every directory is recorded by device and inode before it's read, so a symlink back up the tree (or two roots
+    // that overlap) can't get a directory read twice.
+    bool FirstVisit(int fd) {
+        struct stat st;
+
+        if (fstat(fd, &st) != 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mVisitedLock);
+        return mVisited.insert({ (uint64_t)st.st_dev, (uint64_t)st.st_ino }).second;
+    }
+
+    void ReadDir(size_t self, const RomCrawlDir& dir) {
+        DIR* d = opendir(dir.path.c_str());
+        struct dirent* entry;
+
+        if (d == nullptr) {
+            return;
+        }
+        if (!FirstVisit(dirfd(d))) {
+            closedir(d);
+            return;
+        }
+        if (dir.depth == 0) {
+            mRootsRead++;
+        }
+        while ((entry = readdir(d)) != nullptr) {
+            const char* name = entry->d_name;
+            unsigned char type = entry->d_type;
+            RomCandidate candidate;
+
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            if (type == DT_LNK && !mOptions->followSymlinks) {
+                continue;
+            }
+            const std::string path = RomDiscoveryJoin(dir.path, name);
+            if (Excluded(path, name)) {
+                continue;
+            }
+            if (type == DT_LNK || type == DT_UNKNOWN) {
+                // Only the listing's type is free. For these, find out what the name really is.
+                struct stat st;
+
+                if (fstatat(dirfd(d), name, &st, 0) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+            if (type == DT_DIR) {
+                if (CanDescend(dir.depth)) {
+                    Push(self, { path, dir.depth + 1 });
+                }
+                continue;
+            }
+            if (type != DT_REG) {
+                continue;
+            }
+            const bool named = RomDiscovery_HasRomExtension(name);
+            if ((!named && !mOptions->sniff) || !RomDiscoveryStatAt(dirfd(d), name, &candidate) ||
+                !RomDiscovery_IsRomSize(candidate.size)) {
+                continue;
+            }
+            if (named) {
+                Found(&candidate, path);
+            } else {
+                Sniff(candidate, path);
+            }
+        }
+        closedir(d);
+    }
+
+    std::mutex mVisitedLock;
+    std::set<std::pair<uint64_t, uint64_t>> mVisited;
+#endif
+
+    const RomCrawlOptions* mOptions;
+    RomCandidateCallback mCallback;
+    void* mUser;
+    std::vector<RomCrawlQueue> mQueues;
+    std::atomic<size_t> mPending{ 0 };
+    // Directories sitting in a queue, not yet taken.
+    std::atomic<size_t> mQueued{ 0 };
+    std::mutex mIdleLock;
+    std::condition_variable mIdle;
+    std::atomic<size_t> mRootsRead{ 0 };
+    std::mutex mCallbackLock;
+    std::mutex mSniffLock;
+    std::vector<std::pair<std::string, RomCandidate>> mSniffs;
+};
+
+void RomDiscoverySniffed(void* user, size_t index, const RomBatchResult* result) {
+    static const unsigned char magic[] = { 0x80, 0x37, 0x12, 0x40 };
+
+    // The probed header is already big endian, so one magic covers all three byte orders.
+    ((int*)user)[index] = result->ok && memcmp(result->header, magic, sizeof(magic)) == 0;
+}
+
+} // namespace
+
+extern "C" int RomDiscovery_IsRomSize(uint64_t size) {
+    return size == ROM_SIZE_32MB || size == ROM_SIZE_54MB || size == ROM_SIZE_64MB;
+}
+
+extern "C" int RomDiscovery_HasRomExtension(const char* name) {
+    static const char* const extensions[] = { "z64", "n64", "v64" };
+    const char* ext = strrchr(name, '.');
+
+    if (ext == nullptr || strlen(ext + 1) != 3) {
+        return 0;
+    }
+    for (const char* known : extensions) {
+        if (tolower((unsigned char)ext[1]) == known[0] && tolower((unsigned char)ext[2]) == known[1] &&
+            tolower((unsigned char)ext[3]) == known[2]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+extern "C" void RomDiscovery_Sniff(const char* const* paths, size_t count, int* isRom) {
+    memset(isRom, 0, count * sizeof(*isRom));
+    RomBatch_Run(paths, count, ROM_BATCH_PROBE, nullptr, RomDiscoverySniffed, isRom);
+}
+
+extern "C" int RomDiscovery_Excluded(const RomCrawlOptions* options, const char* path, const char* name) {
+    for (size_t i = 0; i < options->excludeCount; i++) {
+        const char* pattern = options->excludes[i];
+
+        // Patterns with a separator are matched against the whole path, others against the name alone.
+        if (RomDiscoveryGlob(pattern, strpbrk(pattern, "/\\") != nullptr ? path : name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+extern "C" int RomDiscovery_Crawl(const RomCrawlOptions* options, RomCandidateCallback callback, void* user) {
+    RomCrawler crawler(options, callback, user);
+
+    return crawler.Run();
+}
+
+extern "C" int RomDiscovery_Stat(const char* path, RomCandidate* candidate) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data) || data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        return 0;
+    }
+    candidate->size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    candidate->mtime =
+        (int64_t)(((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime);
+    candidate->device = 0;
+    candidate->inode = RomDiscoveryHashPath(path);
+    return 1;
+#else
+    return RomDiscoveryStatAt(AT_FDCWD, path, candidate);
+#endif
+}
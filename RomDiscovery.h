@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The only sizes a supported ROM comes in. Anything else is rejected before it's opened.
+#define ROM_SIZE_32MB (32ull * 1024 * 1024)
+#define ROM_SIZE_54MB (54ull * 1024 * 1024)
+#define ROM_SIZE_64MB (64ull * 1024 * 1024)
+
+typedef struct RomCandidate {
+    // Relative to the working directory if the scanned directory was ".", otherwise the directory joined with the name.
+    const char* path;
+    uint64_t size;
+    // Last modification, in nanoseconds since the epoch on POSIX and in FILETIME units on Windows.
+    int64_t mtime;
+    // Identity of the file, which survives renames. Windows has no cheap equivalent, so there device is 0 and inode is
+    // a hash of the path.
+    uint64_t device;
+    uint64_t inode;
+} RomCandidate;
+
+// Called for each candidate. candidate and its path are only valid during the call.
+typedef void (*RomCandidateCallback)(void* user, const RomCandidate* candidate);
+
+int RomDiscovery_IsRomSize(uint64_t size);
+// True for .z64, .n64 and .v64, in any case.
+int RomDiscovery_HasRomExtension(const char* name);
+
+typedef struct RomCrawlOptions {
+    const char* const* roots;
+    size_t rootCount;
+    // How many levels below a root to descend. 0 reads only the roots, negative means no limit.
+    int maxDepth;
+    // Names to skip, files and directories alike. '*' and '?' wildcards. A pattern with a path separator is matched
+    // against the whole path instead of the name.
+    const char* const* excludes;
+    size_t excludeCount;
+    // Follow symlinks to files and directories. Directories are only ever read once, so links can't cause loops.
+    // Windows never enters junctions or directory links.
+    int followSymlinks;
+    // Workers reading directories. 0 uses one per hardware thread.
+    unsigned threadCount;
+    // Also accept ROM sized files without a ROM extension (.rom, .bin, none at all) if they start like an N64 ROM in
+    // any byte order. Only files that pass the size check are read, and those reads are batched.
+    int sniff;
+} RomCrawlOptions;
+
+// Reads the start of every path as one batch and sets isRom[i] if it's an N64 ROM header, big endian, byte swapped
+// or word swapped.
+void RomDiscovery_Sniff(const char* const* paths, size_t count, int* isRom);
+
+// True if path (whose last component is name) matches one of the options' excludes.
+int RomDiscovery_Excluded(const RomCrawlOptions* options, const char* path, const char* name);
+
+// Walks the roots on several threads and reports every regular file with a ROM extension and a ROM size as soon as
+// it's found. Entries are filtered on their type and name first, from the directory listing alone, so only real
+// candidates are ever stat'ed. The callback is called from the crawler's threads, never concurrently. Returns 0 if no
+// root could be read.
+int RomDiscovery_Crawl(const RomCrawlOptions* options, RomCandidateCallback callback, void* user);
+
+// Fills in everything but path for a single file, following symlinks. Returns 0 if it isn't a readable regular file.
+int RomDiscovery_Stat(const char* path, RomCandidate* candidate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,148 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RomLoader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maps the whole file read only and asks the kernel to fault it in ahead of the hash, which reads it front to back
+// exactly once. Nothing writes to the mapping (header fixes are applied to a copy), so it never needs to be writable
+// and no page is ever copied.
+static int RomImageMap(RomImage* image, const char* path) {
+#ifdef _WIN32
+    HANDLE file =
+        CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    HANDLE mapping;
+    LARGE_INTEGER size;
+    void* view;
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return 0;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return 0;
+    }
+    // The view keeps the mapping and the file alive on its own.
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) {
+        return 0;
+    }
+    image->data = (const unsigned char*)view;
+    image->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    int flags = MAP_PRIVATE;
+    void* view;
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    view = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return 0;
+    }
+    // Readahead hints. MAP_POPULATE already did the work where it exists, so these only matter elsewhere.
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(view, (size_t)st.st_size, MADV_WILLNEED);
+    image->data = (const unsigned char*)view;
+    image->size = (size_t)st.st_size;
+#endif
+    image->mapped = 1;
+    return 1;
+}
+
+static int RomImageRead(RomImage* image, const char* path) {
+    FILE* file = fopen(path, "rb");
+    RomBuffer buffer;
+    long size;
+
+    if (file == NULL) {
+        return 0;
+    }
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+    buffer = RomBuffer_Acquire((size_t)size);
+    if (buffer.data == NULL || fread(buffer.data, 1, (size_t)size, file) != (size_t)size) {
+        RomBuffer_Release(buffer);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    image->data = buffer.data;
+    image->size = (size_t)size;
+    image->mapped = 0;
+    image->buffer = buffer;
+    return 1;
+}
+
+// -1 until set or read from the environment.
+static int sDirectIo = -1;
+
+void RomLoader_SetDirectIo(int enable) {
+    sDirectIo = enable != 0;
+}
+
+int RomLoader_DirectIo(void) {
+    if (sDirectIo < 0) {
+        const char* env = getenv(ROM_DIRECT_IO_ENV);
+
+        sDirectIo = env != NULL && atoi(env) != 0;
+    }
+    return sDirectIo;
+}
+
+int RomImage_Open(RomImage* image, const char* path) {
+    memset(image, 0, sizeof(*image));
+    return RomImageMap(image, path) || RomImageRead(image, path);
+}
+
+void RomImage_Close(RomImage* image) {
+    if (image->data != NULL) {
+        if (!image->mapped) {
+            RomBuffer_Release(image->buffer);
+        } else {
+#ifdef _WIN32
+            UnmapViewOfFile(image->data);
+#else
+            munmap((void*)image->data, image->size);
+#endif
+        }
+    }
+    memset(image, 0, sizeof(*image));
+}
+
+#ifdef __cplusplus
+}
+#endif
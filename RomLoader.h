@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "EndianCvt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buffers big enough for a whole ROM, handed out uninitialized and sized to the file rather than the largest ROM. A
+// released buffer is kept for the next file, so a batch pays for its allocations (and page faults) once.
+#define ROM_BUFFER_POOL_SLOTS 8
+// Capacities are rounded up to this, so buffers for slightly different sizes can be shared.
+#define ROM_BUFFER_GRANULE (64 * 1024)
+// Buffers at least this big are rounded up to it and backed by huge pages where the OS allows. A 64MB ROM is then 32
+// TLB entries and page faults instead of 16k.
+#define ROM_BUFFER_HUGE_PAGE (2 * 1024 * 1024)
+
+typedef enum RomBufferBacking {
+    // Ordinary heap memory.
+    ROM_BUFFER_HEAP,
+    // Anonymous memory marked MADV_HUGEPAGE, on a system with THP enabled. The kernel backs it with transparent huge
+    // pages as long as it can find free 2MB ranges.
+    ROM_BUFFER_THP,
+    // Reserved huge pages from MAP_HUGETLB.
+    ROM_BUFFER_HUGETLB,
+} RomBufferBacking;
+
+typedef struct RomBuffer {
+    unsigned char* data;
+    size_t capacity;
+    RomBufferBacking backing;
+} RomBuffer;
+
+// Returns a pooled buffer of at least size bytes (and at most about twice that), or a new one. data is NULL if the
+// allocation failed.
+RomBuffer RomBuffer_Acquire(size_t size);
+// Hands the buffer back to the pool, or frees it if the pool is full. Safe to call with an empty buffer.
+void RomBuffer_Release(RomBuffer buffer);
+// Frees every pooled buffer. For when a batch is over and the memory won't be wanted again soon.
+void RomBuffer_Trim(void);
+const char* RomBuffer_BackingName(RomBufferBacking backing);
+
+// A ROM file's contents, in the file's byte order. Normally a read only mapping of the file, so the bytes come straight
+// from the page cache with no copy into a user buffer. Falls back to reading into a heap buffer if the file can't be
+// mapped.
+typedef struct RomImage {
+    const unsigned char* data;
+    size_t size;
+    int mapped;
+    // Where data lives when the file isn't mapped.
+    RomBuffer buffer;
+} RomImage;
+
+// Opens path into image. Returns 0 on failure, leaving image empty. The caller must RomImage_Close a successfully
+// opened image.
+int RomImage_Open(RomImage* image, const char* path);
+// Releases the image and empties it. Safe to call on an empty image.
+void RomImage_Close(RomImage* image);
+
+// Environment variable that turns on direct I/O, e.g. OTR_DIRECT_IO=1.
+#define ROM_DIRECT_IO_ENV "OTR_DIRECT_IO"
+// Alignment of buffers, offsets and lengths for direct reads. A page, which covers every common logical block size.
+#define ROM_DIRECT_IO_ALIGN 4096
+
+// Opt in to reading ROMs around the page cache in RomHashFile, for bulk validation where every file is read once and
+// caching it would only evict something more useful. Off by default. Until set, follows ROM_DIRECT_IO_ENV. Ignored
+// where the OS or filesystem can't do it.
+void RomLoader_SetDirectIo(int enable);
+int RomLoader_DirectIo(void);
+
+// Size of the N64 header at the start of every ROM.
+#define ROM_HEADER_SIZE 0x40
+
+// The pipelined reader keeps ROM_PIPELINE_DEPTH chunks of ROM_PIPELINE_CHUNK bytes in flight.
+#define ROM_PIPELINE_CHUNK (1024 * 1024)
+#define ROM_PIPELINE_DEPTH 4
+
+typedef struct RomFileHash {
+    // RomToBigEndianCrc32C of the whole file.
+    uint32_t crc;
+    uint64_t size;
+    // The start of the ROM, big endian and fixed up.
+    unsigned char header[ROM_HEADER_SIZE];
+    // First byte of the file as stored: 0x80 for z64, 0x37 for v64, 0x40 for n64.
+    unsigned char byteOrder;
+    // What the file was read into: the ring, or the fallback's buffer. ROM_BUFFER_HEAP if the fallback mapped it.
+    RomBufferBacking backing;
+} RomFileHash;
+
+// Reads path on an I/O thread into a ring of chunks while the calling thread swaps and hashes the chunks already read,
+// so a cold read costs about max(I/O, hash) instead of the sum. Memory use is the ring, whatever the file size. Falls
+// back to a RomImage if the thread can't be started. Returns 0 if the file can't be read or is smaller than a header.
+int RomHashFile(const char* path, RomHeaderFixup fixHeader, RomFileHash* hash);
+
+// How much of each file a batch probe reads. Header plus boot code, enough to identify a ROM.
+#define ROM_BATCH_PROBE_SIZE 0x1000
+// Reads the batch keeps queued at once, and the largest single read. Full reads are split into pieces this big.
+#define ROM_BATCH_QUEUE_DEPTH 64
+#define ROM_BATCH_READ_SIZE (1024 * 1024)
+// Upper bound on the buffers of full reads in flight. One file is always admitted, however big.
+#define ROM_BATCH_MEMORY (256 * 1024 * 1024)
+// Workers for the fallback when io_uring isn't available.
+#define ROM_BATCH_PROBE_THREADS 16
+#define ROM_BATCH_READ_THREADS 4
+
+typedef enum RomBatchMode {
+    // Read the first ROM_BATCH_PROBE_SIZE bytes of each file. crc is left 0.
+    ROM_BATCH_PROBE,
+    // Read and hash each file whole.
+    ROM_BATCH_FULL,
+} RomBatchMode;
+
+typedef struct RomBatchResult {
+    // 0 if the file couldn't be read or is smaller than a header. Nothing else is set then.
+    int ok;
+    // Size of the whole file, even when probing.
+    uint64_t size;
+    // Same as RomFileHash.
+    uint32_t crc;
+    unsigned char header[ROM_HEADER_SIZE];
+    unsigned char byteOrder;
+    // What the file was read into.
+    RomBufferBacking backing;
+} RomBatchResult;
+
+// Called once per path, in completion order rather than path order. Never called concurrently, but with the fallback
+// it's called from worker threads.
+typedef void (*RomBatchCallback)(void* user, size_t index, const RomBatchResult* result);
+
+// Reads many files at once to keep a deep I/O queue, instead of one blocking read at a time. Uses io_uring on Linux,
+// and otherwise a pool of threads doing blocking reads. Returns when every path has had its callback.
+void RomBatch_Run(const char* const* paths, size_t count, RomBatchMode mode, RomHeaderFixup fixHeader,
+                  RomBatchCallback callback, void* user);
+
+#ifdef __cplusplus
+}
+#endif
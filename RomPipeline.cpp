@@ -0,0 +1,247 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <semaphore>
+#include <system_error>
+#include <thread>
+
+#include "RomLoader.h"
+
+#if !defined(_WIN32) && (defined(O_DIRECT) || defined(F_NOCACHE))
+#define ROM_HAVE_DIRECT_IO
+#endif
+
+namespace {
+
+// Where the I/O thread gets its chunks from. Normally buffered stdio. With direct I/O on, the aligned bulk of the file
+// is read around the page cache and only the unaligned tail goes through it.
+class RomPipelineSource {
+  public:
+    ~RomPipelineSource() {
+        if (mFile != nullptr) {
+            fclose(mFile);
+        }
+#ifdef ROM_HAVE_DIRECT_IO
+        if (mDirectFd >= 0) {
+            close(mDirectFd);
+        }
+        if (mTailFd >= 0) {
+            close(mTailFd);
+        }
+#endif
+    }
+
+    bool Open(const char* path) {
+#ifdef ROM_HAVE_DIRECT_IO
+        if (RomLoader_DirectIo() && OpenDirect(path)) {
+            return true;
+        }
+#endif
+        mFile = fopen(path, "rb");
+        if (mFile == nullptr) {
+            return false;
+        }
+        // The chunks are already big reads into our own buffers. stdio buffering would only add a copy.
+        setvbuf(mFile, nullptr, _IONBF, 0);
+        return true;
+    }
+
+    // Fills buffer with up to size bytes. size must be a multiple of ROM_DIRECT_IO_ALIGN and buffer aligned to it.
+    // Fewer than size bytes means the end of the file or an error.
+    size_t Read(unsigned char* buffer, size_t size) {
+#ifdef ROM_HAVE_DIRECT_IO
+        if (mTailFd >= 0) {
+            return ReadDirect(buffer, size);
+        }
+#endif
+        const size_t got = fread(buffer, 1, size, mFile);
+
+        mError = mError || ferror(mFile) != 0;
+        return got;
+    }
+
+    bool Failed() const {
+        return mError;
+    }
+
+  private:
+#ifdef ROM_HAVE_DIRECT_IO
+    bool OpenDirect(const char* path) {
+        struct stat st;
+
+#ifdef O_DIRECT
+        mDirectFd = open(path, O_RDONLY | O_DIRECT);
+#else
+        mDirectFd = open(path, O_RDONLY);
+        if (mDirectFd >= 0 && fcntl(mDirectFd, F_NOCACHE, 1) != 0) {
+            close(mDirectFd);
+            mDirectFd = -1;
+        }
+#endif
+        // Some filesystems (tmpfs for one) refuse O_DIRECT outright. Those just get buffered reads.
+        if (mDirectFd < 0) {
+            return false;
+        }
+        mTailFd = open(path, O_RDONLY);
+        if (mTailFd < 0 || fstat(mDirectFd, &st) != 0) {
+            close(mDirectFd);
+            mDirectFd = -1;
+            if (mTailFd >= 0) {
+                close(mTailFd);
+                mTailFd = -1;
+            }
+            return false;
+        }
+        mSize = (uint64_t)st.st_size;
+        mAlignedEnd = mSize & ~(uint64_t)(ROM_DIRECT_IO_ALIGN - 1);
+        return true;
+    }
+
+    size_t ReadDirect(unsigned char* buffer, size_t size) {
+        size_t got = 0;
+
+        while (got < size && mOffset < mSize) {
+            // The aligned bulk comes straight off the device. The tail can't, since O_DIRECT reads whole blocks, so it
+            // goes through the page cache.
+            const bool direct = mDirectFd >= 0 && mOffset < mAlignedEnd;
+            const size_t want = (size_t)std::min<uint64_t>(size - got, (direct ? mAlignedEnd : mSize) - mOffset);
+            const ssize_t n = pread(direct ? mDirectFd : mTailFd, buffer + got, want, (off_t)mOffset);
+
+            if (n < 0 && direct && errno == EINVAL) {
+                // The open worked but the reads don't: a logical block bigger than ROM_DIRECT_IO_ALIGN, or a FUSE or
+                // network filesystem that wants its own alignment. Finish the file with buffered reads.
+                close(mDirectFd);
+                mDirectFd = -1;
+                continue;
+            }
+            if (n <= 0) {
+                mError = true;
+                break;
+            }
+            got += (size_t)n;
+            mOffset += (uint64_t)n;
+        }
+        return got;
+    }
+
+    int mDirectFd = -1;
+    int mTailFd = -1;
+    uint64_t mSize = 0;
+    uint64_t mAlignedEnd = 0;
+    uint64_t mOffset = 0;
+#endif
+    FILE* mFile = nullptr;
+    bool mError = false;
+};
+
+// Same result without the pipeline, for when the I/O thread can't be created.
+int RomHashImage(const char* path, RomHeaderFixup fixHeader, RomFileHash* hash) {
+    RomImage image;
+
+    if (!RomImage_Open(&image, path)) {
+        return 0;
+    }
+    if (image.size < ROM_HEADER_SIZE) {
+        RomImage_Close(&image);
+        return 0;
+    }
+    hash->byteOrder = image.data[0];
+    RomCopyToBigEndian(hash->header, image.data, ROM_HEADER_SIZE);
+    if (fixHeader != nullptr) {
+        fixHeader(hash->header, ROM_HEADER_SIZE);
+    }
+    hash->crc = RomCrc32CAsBigEndian(image.data, image.size, fixHeader);
+    hash->size = image.size;
+    hash->backing = image.mapped ? ROM_BUFFER_HEAP : image.buffer.backing;
+    RomImage_Close(&image);
+    return 1;
+}
+
+} // namespace
+
+extern "C" int RomHashFile(const char* path, RomHeaderFixup fixHeader, RomFileHash* hash) {
+    // One allocation for the whole ring, aligned for direct I/O. The footprint is the same however big the file is.
+    RomBuffer storage;
+    unsigned char* ring[ROM_PIPELINE_DEPTH];
+    size_t sizes[ROM_PIPELINE_DEPTH];
+    std::counting_semaphore<ROM_PIPELINE_DEPTH> freeChunks(ROM_PIPELINE_DEPTH);
+    std::counting_semaphore<ROM_PIPELINE_DEPTH> fullChunks(0);
+    RomPipelineSource source;
+    std::thread ioThread;
+    RomCrc32CState state;
+
+    if (!source.Open(path)) {
+        return 0;
+    }
+    storage = RomBuffer_Acquire(ROM_PIPELINE_DEPTH * ROM_PIPELINE_CHUNK + ROM_DIRECT_IO_ALIGN);
+    if (storage.data == nullptr) {
+        return 0;
+    }
+    hash->backing = storage.backing;
+    const uintptr_t base = ((uintptr_t)storage.data + ROM_DIRECT_IO_ALIGN - 1) & ~(uintptr_t)(ROM_DIRECT_IO_ALIGN - 1);
+    for (size_t i = 0; i < ROM_PIPELINE_DEPTH; i++) {
+        ring[i] = (unsigned char*)base + i * ROM_PIPELINE_CHUNK;
+    }
+
+    try {
+        ioThread = std::thread([&]() {
+            for (size_t i = 0;; i++) {
+                const size_t slot = i % ROM_PIPELINE_DEPTH;
+
+                freeChunks.acquire();
+                sizes[slot] = source.Read(ring[slot], ROM_PIPELINE_CHUNK);
+                fullChunks.release();
+                // A short read is the end of the file, or an error. Either way it's the last chunk.
+                if (sizes[slot] < ROM_PIPELINE_CHUNK) {
+                    return;
+                }
+            }
+        });
+    } catch (const std::system_error&) {
+        RomBuffer_Release(storage);
+        return RomHashImage(path, fixHeader, hash);
+    }
+
+    RomCrc32C_Init(&state);
+    hash->size = 0;
+    for (size_t i = 0;; i++) {
+        const size_t slot = i % ROM_PIPELINE_DEPTH;
+        size_t size;
+
+        fullChunks.acquire();
+        size = sizes[slot];
+        if (i == 0 && size != 0) {
+            hash->byteOrder = ring[slot][0];
+        }
+        RomCrc32C_Update(&state, ring[slot], size, fixHeader);
+        if (i == 0) {
+            memcpy(hash->header, ring[slot], size < ROM_HEADER_SIZE ? size : ROM_HEADER_SIZE);
+        }
+        hash->size += size;
+        freeChunks.release();
+        if (size < ROM_PIPELINE_CHUNK) {
+            break;
+        }
+    }
+    ioThread.join();
+    RomBuffer_Release(storage);
+
+    // The I/O thread is done, so its error flag can be read without the semaphores.
+    if (source.Failed() || hash->size < ROM_HEADER_SIZE) {
+        return 0;
+    }
+    hash->crc = RomCrc32C_Final(&state);
+    return 1;
+}
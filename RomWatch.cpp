@@ -0,0 +1,442 @@
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <signal.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RomWatch.h"
+
+namespace {
+
+volatile sig_atomic_t sStop = 0;
+
+#ifdef __linux__
+
+// Write end of a pipe the poll loop also waits on, or -1. A stop that lands between the sStop check and poll would
+// otherwise go unseen until the next event.
+volatile sig_atomic_t sWake = -1;
+
+using RomWatchClock = std::chrono::steady_clock;
+
+struct RomWatchDir {
+    std::string path;
+    int depth;
+    std::pair<uint64_t, uint64_t> id;
+};
+
+// A file that changed recently. It's reported once a stat a debounce period after the last event matches the one
+// before it.
+struct RomWatchPending {
+    RomWatchClock::time_point due;
+    RomCandidate last;
+    bool haveLast;
+};
+
+const char* RomWatchName(const std::string& path) {
+    const size_t slash = path.rfind('/');
+
+    return slash == std::string::npos ? path.c_str() : path.c_str() + slash + 1;
+}
+
+std::string RomWatchJoin(const std::string& dir, const char* name) {
+    if (dir == ".") {
+        return name;
+    }
+    return dir.back() == '/' ? dir + name : dir + '/' + name;
+}
+
+class RomWatcher {
+  public:
+    RomWatcher(const RomCrawlOptions* options, RomWatchCallback callback, void* user)
+        : mOptions(options), mCallback(callback), mUser(user) {
+    }
+
+    ~RomWatcher() {
+        if (mWake[1] >= 0) {
+            sWake = -1;
+            close(mWake[1]);
+            close(mWake[0]);
+        }
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+    int Run() {
+        mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (mFd < 0 || pipe2(mWake, O_NONBLOCK | O_CLOEXEC) != 0) {
+            return 0;
+        }
+        sWake = mWake[1];
+        for (size_t i = 0; i < mOptions->rootCount; i++) {
+            AddTree(mOptions->roots[i], 0);
+        }
+        if (mDirs.empty()) {
+            return 0;
+        }
+        RomDiscovery_Crawl(mOptions, OnExisting, this);
+        Flush();
+
+        while (!sStop) {
+            pollfd pfds[2] = { { mFd, POLLIN, 0 }, { mWake[0], POLLIN, 0 } };
+
+            if (poll(pfds, 2, NextTimeout()) < 0 && errno != EINTR) {
+                return 0;
+            }
+            if (pfds[1].revents & POLLIN) {
+                break;
+            }
+            if (pfds[0].revents & POLLIN) {
+                ReadEvents();
+            }
+            ReportSettled();
+            Flush();
+        }
+        return 1;
+    }
+
+  private:
+    // Only collects. This runs under the crawler's callback lock, so validating here would stall every crawl worker.
+    static void OnExisting(void* user, const RomCandidate* candidate) {
+        RomWatcher* self = (RomWatcher*)user;
+
+        self->Added(candidate);
+    }
+
+    void Added(const RomCandidate* candidate) {
+        mFoundPaths.push_back(candidate->path);
+        mFound.push_back(*candidate);
+    }
+
+    // Reports everything found since the last call in one go.
+    void Flush() {
+        if (mFound.empty()) {
+            return;
+        }
+        for (size_t i = 0; i < mFound.size(); i++) {
+            mFound[i].path = mFoundPaths[i].c_str();
+            // Removal of a sniffed file can't be sniffed, so remember which ones were reported.
+            if (!RomDiscovery_HasRomExtension(RomWatchName(mFoundPaths[i]))) {
+                mSniffed.insert(mFoundPaths[i]);
+            }
+        }
+        mCallback(mUser, ROM_WATCH_ADDED, mFound.data(), mFound.size());
+        mFound.clear();
+        mFoundPaths.clear();
+    }
+
+    void Removed(const std::string& path) {
+        RomCandidate gone = {};
+
+        // A file found and then removed in the same round is reported in that order.
+        Flush();
+        gone.path = path.c_str();
+        mCallback(mUser, ROM_WATCH_REMOVED, &gone, 1);
+    }
+
+    bool CanDescend(int depth) const {
+        return mOptions->maxDepth < 0 || depth < mOptions->maxDepth;
+    }
+
+    // Follows directory links the same way the crawler does: always for a root, below that only with followSymlinks.
+    // A directory reachable by more than one path is watched once, under the first, so links can't cause loops.
+    void AddTree(const std::string& path, int depth) {
+        const bool follow = depth == 0 || mOptions->followSymlinks;
+        struct stat st;
+        DIR* d;
+        struct dirent* entry;
+
+        if ((follow ? stat(path.c_str(), &st) : lstat(path.c_str(), &st)) != 0 || !S_ISDIR(st.st_mode)) {
+            return;
+        }
+        const std::pair<uint64_t, uint64_t> id = { (uint64_t)st.st_dev, (uint64_t)st.st_ino };
+        if (!mWatched.insert(id).second) {
+            return;
+        }
+        const int wd = inotify_add_watch(mFd, path.c_str(),
+                                         IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_MODIFY |
+                                             IN_CREATE | IN_ONLYDIR | IN_EXCL_UNLINK | (follow ? 0 : IN_DONT_FOLLOW));
+        if (wd < 0 || mDirs.count(wd) != 0) {
+            if (wd < 0) {
+                mWatched.erase(id);
+            }
+            return;
+        }
+        mDirs[wd] = { path, depth, id };
+        if (!CanDescend(depth) || (d = opendir(path.c_str())) == nullptr) {
+            return;
+        }
+        while ((entry = readdir(d)) != nullptr) {
+            unsigned char type = entry->d_type;
+
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            if (type == DT_LNK && !mOptions->followSymlinks) {
+                continue;
+            }
+            if (type == DT_LNK || type == DT_UNKNOWN) {
+                // Only the listing's type is free. For these, find out what the name really is.
+                if (fstatat(dirfd(d), entry->d_name, &st, mOptions->followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : DT_UNKNOWN;
+            }
+            if (type != DT_DIR) {
+                continue;
+            }
+            const std::string child = RomWatchJoin(path, entry->d_name);
+            if (!RomDiscovery_Excluded(mOptions, child.c_str(), entry->d_name)) {
+                AddTree(child, depth + 1);
+            }
+        }
+        closedir(d);
+    }
+
+    // A directory that shows up later may already hold ROMs, e.g. when a whole folder is moved in.
+    void AddNewDir(const std::string& path, int depth) {
+        RomCrawlOptions options = *mOptions;
+        const char* root = path.c_str();
+
+        AddTree(path, depth);
+        options.roots = &root;
+        options.rootCount = 1;
+        options.maxDepth = mOptions->maxDepth < 0 ? -1 : mOptions->maxDepth - depth;
+        options.threadCount = 1;
+        RomDiscovery_Crawl(&options, OnExisting, this);
+    }
+
+    // A directory moved out of the tree keeps its watches, which would report files under the old path.
+    // Forgets them straight away, so the same directory moved back in is watched again.
+    void RemoveTree(const std::string& path) {
+        for (auto it = mDirs.begin(); it != mDirs.end();) {
+            const std::string& dir = it->second.path;
+
+            if (dir.compare(0, path.size(), path) == 0 && (dir.size() == path.size() || dir[path.size()] == '/')) {
+                // The IN_IGNORED that follows finds nothing to drop.
+                inotify_rm_watch(mFd, it->first);
+                mWatched.erase(it->second.id);
+                it = mDirs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    int NextTimeout() const {
+        RomWatchClock::time_point next = RomWatchClock::time_point::max();
+
+        if (mPending.empty()) {
+            return -1;
+        }
+        for (const auto& [path, pending] : mPending) {
+            next = std::min(next, pending.due);
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - RomWatchClock::now()).count();
+        return wait < 0 ? 0 : (int)wait + 1;
+    }
+
+    void Touch(const std::string& path, bool closed) {
+        RomWatchPending& pending = mPending[path];
+
+        pending.due = RomWatchClock::now() + std::chrono::milliseconds(ROM_WATCH_DEBOUNCE_MS);
+        // A close after writing, or a rename into place, usually means the file is done. Stat it now so it can be
+        // reported after one quiet period instead of two.
+        pending.haveLast = closed && RomDiscovery_Stat(path.c_str(), &pending.last);
+    }
+
+    void ReadEvents() {
+        alignas(inotify_event) char buffer[16 * 1024];
+        ssize_t length;
+
+        while ((length = read(mFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len) {
+                const inotify_event* event = (const inotify_event*)p;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Events were lost. Report everything again rather than miss a ROM.
+                    RomDiscovery_Crawl(mOptions, OnExisting, this);
+                    continue;
+                }
+                const auto dir = mDirs.find(event->wd);
+                if (dir == mDirs.end()) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    mWatched.erase(dir->second.id);
+                    mDirs.erase(dir);
+                    continue;
+                }
+                if (event->len == 0) {
+                    continue;
+                }
+                const std::string path = RomWatchJoin(dir->second.path, event->name);
+                if (RomDiscovery_Excluded(mOptions, path.c_str(), event->name)) {
+                    continue;
+                }
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO) && CanDescend(dir->second.depth)) {
+                        AddNewDir(path, dir->second.depth + 1);
+                    } else if (event->mask & IN_MOVED_FROM) {
+                        RemoveTree(path);
+                    }
+                    continue;
+                }
+                if (mOptions->followSymlinks && IsDirLink(path, dir->second.depth, event->mask)) {
+                    continue;
+                }
+                const bool named = RomDiscovery_HasRomExtension(event->name);
+                if (!named && !mOptions->sniff) {
+                    continue;
+                }
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    mPending.erase(path);
+                    if (!named && mSniffed.erase(path) == 0) {
+                        continue;
+                    }
+                    Removed(path);
+                } else {
+                    Touch(path, (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0);
+                }
+            }
+        }
+    }
+
+    // A link to a directory comes and goes as a plain entry. Treats it like the directory itself. Returns true if the
+    // event was about one.
+    bool IsDirLink(const std::string& path, int depth, uint32_t mask) {
+        struct stat st;
+
+        if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+            // Gone, so there's nothing to stat. Dropping watches under a path that was never a directory is harmless.
+            RemoveTree(path);
+            return false;
+        }
+        if (!(mask & (IN_CREATE | IN_MOVED_TO)) || lstat(path.c_str(), &st) != 0 || !S_ISLNK(st.st_mode) ||
+            stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return false;
+        }
+        if (CanDescend(depth)) {
+            AddNewDir(path, depth + 1);
+        }
+        return true;
+    }
+
+    void ReportSettled() {
+        const RomWatchClock::time_point now = RomWatchClock::now();
+        std::vector<RomCandidate> settled;
+        std::vector<std::string> settledPaths;
+        std::vector<const char*> sniffPaths;
+        std::vector<size_t> sniffing;
+
+        for (auto it = mPending.begin(); it != mPending.end();) {
+            RomWatchPending& pending = it->second;
+            RomCandidate current;
+
+            if (pending.due > now) {
+                ++it;
+                continue;
+            }
+            if (!RomDiscovery_Stat(it->first.c_str(), &current)) {
+                it = mPending.erase(it);
+                continue;
+            }
+            if (!pending.haveLast || current.size != pending.last.size || current.mtime != pending.last.mtime) {
+                // Still changing. Give it another period.
+                pending.last = current;
+                pending.haveLast = true;
+                pending.due = now + std::chrono::milliseconds(ROM_WATCH_DEBOUNCE_MS);
+                ++it;
+                continue;
+            }
+            if (RomDiscovery_IsRomSize(current.size)) {
+                settled.push_back(current);
+                settledPaths.push_back(it->first);
+            }
+            it = mPending.erase(it);
+        }
+        // Files without a ROM extension are only reported if their headers say so. Sniff them all at once.
+        for (size_t i = 0; i < settled.size(); i++) {
+            settled[i].path = settledPaths[i].c_str();
+            if (!RomDiscovery_HasRomExtension(RomWatchName(settledPaths[i]))) {
+                sniffing.push_back(i);
+                sniffPaths.push_back(settled[i].path);
+            }
+        }
+        std::vector<int> isRom(sniffPaths.size(), 0);
+        std::vector<int> keep(settled.size(), 1);
+        if (!sniffPaths.empty()) {
+            RomDiscovery_Sniff(sniffPaths.data(), sniffPaths.size(), isRom.data());
+        }
+        for (size_t i = 0; i < sniffing.size(); i++) {
+            keep[sniffing[i]] = isRom[i];
+        }
+        for (size_t i = 0; i < settled.size(); i++) {
+            if (keep[i]) {
+                Added(&settled[i]);
+            }
+        }
+    }
+
+    const RomCrawlOptions* mOptions;
+    RomWatchCallback mCallback;
+    void* mUser;
+    int mFd = -1;
+    int mWake[2] = { -1, -1 };
+    std::unordered_map<int, RomWatchDir> mDirs;
+    std::map<std::string, RomWatchPending> mPending;
+    std::set<std::string> mSniffed;
+    // Found but not reported yet. The candidates' paths point into mFoundPaths once they're reported.
+    std::vector<RomCandidate> mFound;
+    std::vector<std::string> mFoundPaths;
+    // Device and inode of every watched directory.
+    std::set<std::pair<uint64_t, uint64_t>> mWatched;
+};
+
+#endif
+
+} // namespace
+
+extern "C" int RomWatch_Run(const RomCrawlOptions* options, RomWatchCallback callback, void* user) {
+#ifdef __linux__
+    RomWatcher watcher(options, callback, user);
+
+    sStop = 0;
+    return watcher.Run();
+#else
+    (void)options;
+    (void)callback;
+    (void)user;
+    return 0;
+#endif
+}
+
+extern "C" void RomWatch_Stop(void) {
+    sStop = 1;
+#ifdef __linux__
+    const int wake = sWake;
+
+    if (wake >= 0) {
+        const int saved = errno;
+        const char byte = 0;
+
+        // Nonblocking, and one byte is enough to wake the loop, so a full pipe is fine.
+        (void)!write(wake, &byte, 1);
+        errno = saved;
+    }
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "RomDiscovery.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A file has to sit unchanged this long after its last write before it's reported, so a dump that's still being
+// copied in isn't validated half written.
+#define ROM_WATCH_DEBOUNCE_MS 250
+
+typedef enum RomWatchEvent {
+    // A ROM sized file with a ROM extension (or, when sniffing, a ROM header) appeared, or finished changing.
+    // candidates are complete.
+    ROM_WATCH_ADDED,
+    // A file with a ROM extension, or a sniffed one that was reported, was deleted or moved away. Only path is set,
+    // and count is 1.
+    ROM_WATCH_REMOVED,
+} RomWatchEvent;
+
+// Called on the watching thread, never concurrently. Files that turn up together (those already there at startup, a
+// directory moved in, a rescan after lost events, or several that settle at once) come in one call, so they can be
+// validated as a batch. Removals come one at a time, after anything found before them.
+typedef void (*RomWatchCallback)(void* user, RomWatchEvent event, const RomCandidate* candidates, size_t count);
+
+// Watches the roots (and their subdirectories, down to maxDepth) and reports ROMs as they come and go, until
+// RomWatch_Stop. Watches are set up first and then every existing ROM is reported as added, so nothing copied in
+// during startup is missed. Directory symlinks are followed like the crawler does: always for a root, below that only
+// with followSymlinks, watching each directory once. Returns 0 straight away if watching isn't supported here (it
+// needs inotify) or no root could be watched.
+int RomWatch_Run(const RomCrawlOptions* options, RomWatchCallback callback, void* user);
+// Makes RomWatch_Run return. Async signal safe.
+void RomWatch_Stop(void);
+
+#ifdef __cplusplus
+}
+#endif
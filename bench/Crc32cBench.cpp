@@ -0,0 +1,233 @@
+// Times every CRC32C kernel the machine supports over a range of sizes, start alignments and cache states.
+// Build with `make bench`, run ./crc32c_bench.elf [--json] [--kernel <name>] [--max-size <bytes>].
+
+#include "FastCrc32C.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#define BENCH_HAVE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+static constexpr size_t MAX_SIZE = 64 * 1024 * 1024;
+// Big enough to push a 64MB buffer out of any last level cache we run on.
+static constexpr size_t EVICT_SIZE = 256 * 1024 * 1024;
+static constexpr size_t MISALIGN = 3;
+static constexpr double WARM_SECONDS = 0.05;
+static constexpr int COLD_RUNS = 5;
+
+struct Result {
+    std::string kernel;
+    size_t size;
+    size_t offset;
+    bool cold;
+    double seconds;
+    double cycles;
+};
+
+static uint64_t ReadTsc() {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Gets the buffer out of the caches before a cold run. clflush is exact where we have it, otherwise stream through a
+// buffer much larger than the cache.
+static void Evict(const unsigned char* data, size_t size, unsigned char* evict) {
+#ifdef BENCH_HAVE_TSC
+    (void)evict;
+    for (size_t i = 0; i < size; i += 64) {
+        _mm_clflush(data + i);
+    }
+    _mm_mfence();
+#else
+    (void)data;
+    (void)size;
+    for (size_t i = 0; i < EVICT_SIZE; i += 64) {
+        evict[i]++;
+    }
+#endif
+}
+
+static uint32_t Hash(Crc32cKernel kernel, unsigned char* data, size_t size) {
+    // The sharded path rides on whatever kernel is bound, so it gets its own row with the automatic pick.
+    if (kernel == CRC32C_KERNEL_COUNT) {
+        return CRC32C_Parallel(data, size, 0);
+    }
+    return CRC32C(data, size);
+}
+
+static Result Measure(Crc32cKernel kernel, unsigned char* data, size_t size, bool cold, unsigned char* evict) {
+    std::vector<double> seconds;
+    std::vector<double> cycles;
+    volatile uint32_t sink = 0;
+
+    if (cold) {
+        for (int i = 0; i < COLD_RUNS; i++) {
+            Evict(data, size, evict);
+
+            const uint64_t c0 = ReadTsc();
+            const auto t0 = std::chrono::steady_clock::now();
+            sink = sink + Hash(kernel, data, size);
+            const auto t1 = std::chrono::steady_clock::now();
+            const uint64_t c1 = ReadTsc();
+
+            seconds.push_back(std::chrono::duration<double>(t1 - t0).count());
+            cycles.push_back((double)(c1 - c0));
+        }
+    } else {
+        // Warm up, then batch enough calls per sample that the clock resolution doesn't matter.
+        size_t batch = 1;
+
+        sink = sink + Hash(kernel, data, size);
+        for (;;) {
+            const auto t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < batch; i++) {
+                sink = sink + Hash(kernel, data, size);
+            }
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() > WARM_SECONDS / 10) {
+                break;
+            }
+            batch *= 2;
+        }
+        for (int i = 0; i < 9; i++) {
+            const uint64_t c0 = ReadTsc();
+            const auto t0 = std::chrono::steady_clock::now();
+            for (size_t j = 0; j < batch; j++) {
+                sink = sink + Hash(kernel, data, size);
+            }
+            const auto t1 = std::chrono::steady_clock::now();
+            const uint64_t c1 = ReadTsc();
+
+            seconds.push_back(std::chrono::duration<double>(t1 - t0).count() / batch);
+            cycles.push_back((double)(c1 - c0) / batch);
+        }
+    }
+
+    std::sort(seconds.begin(), seconds.end());
+    std::sort(cycles.begin(), cycles.end());
+    return { kernel == CRC32C_KERNEL_COUNT ? "parallel" : CRC32C_KernelName(kernel),
+             size,
+             (size_t)((uintptr_t)data % 64),
+             cold,
+             seconds[seconds.size() / 2],
+             cycles[cycles.size() / 2] };
+}
+
+static void PrintText(const std::vector<Result>& results) {
+    printf("%-10s %10s %6s %5s %10s %12s\n", "kernel", "size", "offset", "cache", "GB/s", "cycles/byte");
+    for (const auto& r : results) {
+        printf("%-10s %10zu %6zu %5s %10.2f", r.kernel.c_str(), r.size, r.offset, r.cold ? "cold" : "warm",
+               r.size / r.seconds / 1e9);
+#ifdef BENCH_HAVE_TSC
+        printf(" %12.3f\n", r.cycles / r.size);
+#else
+        printf(" %12s\n", "n/a");
+#endif
+    }
+}
+
+static void PrintJson(const std::vector<Result>& results) {
+    printf("[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+
+        printf("  {\"kernel\": \"%s\", \"size\": %zu, \"offset\": %zu, \"cache\": \"%s\", \"seconds\": %.9g, "
+               "\"gb_per_s\": %.4f, ",
+               r.kernel.c_str(), r.size, r.offset, r.cold ? "cold" : "warm", r.seconds, r.size / r.seconds / 1e9);
+#ifdef BENCH_HAVE_TSC
+        printf("\"cycles_per_byte\": %.4f}", r.cycles / r.size);
+#else
+        printf("\"cycles_per_byte\": null}");
+#endif
+        printf("%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    const char* only = nullptr;
+    size_t maxSize = MAX_SIZE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            maxSize = std::min<size_t>(MAX_SIZE, strtoull(argv[++i], nullptr, 0));
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--kernel <name>] [--max-size <bytes>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // 64 byte aligned base so offset 0 really is aligned and MISALIGN really isn't.
+    std::unique_ptr<unsigned char[]> storage(new unsigned char[MAX_SIZE + 128]);
+    unsigned char* base = storage.get() + (64 - (uintptr_t)storage.get() % 64);
+    std::unique_ptr<unsigned char[]> evict;
+
+#ifndef BENCH_HAVE_TSC
+    evict.reset(new unsigned char[EVICT_SIZE]());
+#endif
+    for (size_t i = 0; i < MAX_SIZE + 64; i++) {
+        base[i] = (unsigned char)(i * 2654435761u >> 13);
+    }
+
+    std::vector<Result> results;
+    std::vector<Crc32cKernel> kernels;
+    const Crc32cKernel automatic = CRC32C_GetKernel();
+
+    for (int k = CRC32C_KERNEL_AUTO + 1; k < CRC32C_KERNEL_COUNT; k++) {
+        if (CRC32C_KernelSupported((Crc32cKernel)k)) {
+            kernels.push_back((Crc32cKernel)k);
+        }
+    }
+    // CRC32C_KERNEL_COUNT stands in for the sharded path.
+    kernels.push_back(CRC32C_KERNEL_COUNT);
+
+    for (Crc32cKernel kernel : kernels) {
+        const char* name = kernel == CRC32C_KERNEL_COUNT ? "parallel" : CRC32C_KernelName(kernel);
+
+        if (only != nullptr && strcmp(only, name) != 0) {
+            continue;
+        }
+        CRC32C_SetKernel(kernel == CRC32C_KERNEL_COUNT ? automatic : kernel);
+        if (!json) {
+            fprintf(stderr, "benchmarking %s\n", name);
+        }
+
+        for (size_t size = 64; size <= maxSize; size *= 4) {
+            for (size_t offset : { (size_t)0, MISALIGN }) {
+                for (bool cold : { false, true }) {
+                    results.push_back(Measure(kernel, base + offset, size, cold, evict.get()));
+                }
+            }
+        }
+    }
+
+    if (json) {
+        PrintJson(results);
+    } else {
+        PrintText(results);
+    }
+    return 0;
+}